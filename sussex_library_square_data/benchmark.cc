@@ -0,0 +1,251 @@
+// Standard C++ includes
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+
+// POSIX includes
+#include <dirent.h>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// BoB robotics 3rd party includes
+#include "third_party/path.h"
+
+// BoB robotics includes
+#include "navigation/image_database.h"
+
+// CLI11 includes
+#include "CLI11.hpp"
+
+#include "grid_evaluation.h"
+#include "memory.h"
+#include "memory_factory.h"
+#include "perf_counters.h"
+#include "route.h"
+
+using namespace BoBRobotics;
+using namespace units::literals;
+using namespace units::length;
+using namespace units::angle;
+using namespace units::math;
+
+//------------------------------------------------------------------------
+// Anonymous namespace
+//------------------------------------------------------------------------
+namespace
+{
+// Read DECIMATE_DISTANCE variable from shell script in route directory
+double readDecimateDistance(const filesystem::path &routePath)
+{
+    const filesystem::path decimatePath = routePath / "decimate.sh";
+    std::ifstream decimateFile(decimatePath.str());
+    std::string line;
+    const std::string variable = "DECIMATE_DISTANCE=";
+    while(std::getline(decimateFile, line)) {
+        if(line.compare(0, variable.size(), variable) == 0) {
+            return std::stod(line.substr(variable.size()));
+        }
+    }
+    throw std::runtime_error("Could not read decimate distance from " + decimatePath.str());
+}
+}   // Anonymous namespace
+
+int main(int argc, char **argv)
+{
+    // Default command line arguments
+    int width = 120;
+    int height = 25;
+    std::string imageGridName = "mid_day";
+    std::string outputDirectory = "benchmark_results";
+    std::string routeLookup = "SegmentIndex";
+    std::vector<std::string> routeNames;
+    std::vector<std::string> memoryTypes{"PerfectMemory", "PerfectMemoryConstrained", "InfoMax", "InfoMaxConstrained"};
+    std::vector<std::string> variantNames{"mask", "unwrapped", "skymask", "horizon"};
+    MemoryParameters memoryParameters;
+    unsigned int numThreads = 1;
+    bool skipGridOutputs = false;
+    bool collectPerfCounters = false;
+
+    // Configure command line parser
+    CLI::App app{"BoB robotics vector field benchmark"};
+    app.add_option("--routes", routeNames, "Names of routes to benchmark (all routes if not specified)", false);
+    app.add_option("--memory-types", memoryTypes, "Types of memory to benchmark", true);
+    app.add_option("--variants", variantNames, "Variants of routes and grid to benchmark", true);
+    app.add_option("--grid", imageGridName, "Name of image grid", true);
+    app.add_option("--width", width, "Width of unwrapped image", true);
+    app.add_option("--height", height, "Height of unwrapped image (horizon variant is always 1)", true);
+    app.add_option("--output-directory", outputDirectory, "Directory to write results to", true);
+    app.add_option("--threads", numThreads, "Number of threads to train InfoMax weights and evaluate grid points with", true);
+    app.add_set("--route-lookup", routeLookup, {"Linear", "SegmentIndex", "Raster", "SIMD"},
+                "How to find nearest point on route to each grid point", true);
+    app.add_flag("--skip-grid-outputs", skipGridOutputs,
+                 "Don't write vector field image and CSV for each route, memory type and variant");
+    app.add_flag("--perf-counters", collectPerfCounters,
+                 "Collect hardware performance counters while training memories and testing grid points");
+    addMemoryOptions(app, memoryParameters);
+
+    // Parse command line arguments
+    CLI11_PARSE(app, argc, argv);
+
+    BOB_ASSERT(numThreads > 0);
+    memoryParameters.infoMaxTraining.numThreads = numThreads;
+
+    // If performance counters are required, check they can be opened
+    std::string perfCountersUnavailableReason;
+    if(collectPerfCounters && !PerfCounters::checkAvailable(perfCountersUnavailableReason)) {
+        std::cerr << "Hardware performance counters are unavailable (" << perfCountersUnavailableReason << ") - not collecting" << std::endl;
+        collectPerfCounters = false;
+    }
+
+    // If no routes are specified, use all directories containing routes
+    if(routeNames.empty()) {
+        DIR *routesDirectory = opendir("routes");
+        if(routesDirectory == nullptr) {
+            throw std::runtime_error("Could not open routes directory");
+        }
+        while(const dirent *entry = readdir(routesDirectory)) {
+            const std::string name = entry->d_name;
+            if(name[0] != '.' && (filesystem::path("routes") / name).is_directory()) {
+                routeNames.push_back(name);
+            }
+        }
+        closedir(routesDirectory);
+        std::sort(routeNames.begin(), routeNames.end());
+    }
+
+    // Get image size for variant - **YUCK** horizon 'images' are 720x1
+    auto getImageSize =
+        [width, height](const std::string &variantName)
+        {
+            return cv::Size(width, (variantName == "horizon") ? 1 : height);
+        };
+
+    // Load each variant of grid once
+    std::map<std::string, std::unique_ptr<ImageGrid>> grids;
+    for(const auto &v : variantNames) {
+        grids.emplace(v, std::unique_ptr<ImageGrid>(new ImageGrid(filesystem::path("image_grids") / imageGridName / v,
+                                                                  getImageSize(v))));
+    }
+
+    // Load each variant of each route once and find nearest point on decimated route to every grid point
+    std::map<std::string, std::map<std::string, std::unique_ptr<Navigation::ImageDatabase>>> routes;
+    std::map<std::string, std::map<std::string, cv::Mat>> routePointMats;
+    std::map<std::string, std::map<std::string, cv::Mat>> decimatedRoutePointMats;
+    std::map<std::string, std::map<std::string, std::vector<NearestRoutePoint>>> gridNearestPoints;
+    for(const auto &routeName : routeNames) {
+        const double decimateDistance = readDecimateDistance(filesystem::path("routes") / routeName);
+        for(const auto &v : variantNames) {
+            const filesystem::path routePath = filesystem::path("routes") / routeName / v;
+            routes[routeName].emplace(v, std::unique_ptr<Navigation::ImageDatabase>(new Navigation::ImageDatabase(routePath)));
+
+            std::vector<cv::Point2f> decimatedRoutePoints;
+            processRoute(*routes[routeName][v], decimateDistance, routePointMats[routeName][v],
+                         decimatedRoutePointMats[routeName][v], decimatedRoutePoints);
+            gridNearestPoints[routeName][v] = findNearestRoutePoints(routeLookup, decimatedRoutePoints, *grids[v],
+                                                                     routePath, decimateDistance);
+        }
+    }
+
+    // Get resized snapshots of grid points within R.O.I. of any route, building caches in parallel if necessary
+    for(const auto &v : variantNames) {
+        std::vector<size_t> roiIndices;
+        for(const auto &routeName : routeNames) {
+            const auto routeROIIndices = getROIIndices(gridNearestPoints[routeName][v]);
+            std::vector<size_t> mergedIndices;
+            std::set_union(roiIndices.cbegin(), roiIndices.cend(), routeROIIndices.cbegin(), routeROIIndices.cend(),
+                           std::back_inserter(mergedIndices));
+            roiIndices.swap(mergedIndices);
+        }
+        grids[v]->loadSnapshots(roiIndices, numThreads);
+    }
+
+    // Create output directory and open results CSV
+    filesystem::create_directory(filesystem::path(outputDirectory));
+    std::ofstream outputCSV((filesystem::path(outputDirectory) / "output.csv").str());
+    outputCSV << "Route name, memory type, variant, RMSE, Training time [s], Evaluation time [s]" << std::endl;
+
+    // If performance counters are being collected, open CSV for them
+    std::ofstream perfCountersCSV;
+    if(collectPerfCounters) {
+        perfCountersCSV.open((filesystem::path(outputDirectory) / "perf_counters.csv").str());
+        perfCountersCSV << "Route name, memory type, variant, phase, time [s], ";
+        PerfCounterValues::writeCSVHeader(perfCountersCSV);
+        perfCountersCSV << std::endl;
+    }
+
+    // Create pool of threads to evaluate every grid with
+    WorkerPool workerPool(numThreads);
+
+    for(const auto &routeName : routeNames) {
+        // Loop through memory types and variants and calculate vector field
+        for(const auto &m : memoryTypes) {
+            for(const auto &v : variantNames) {
+                std::cout << routeName << ", " << m << ", " << v << std::endl;
+                const ImageGrid &grid = *grids[v];
+
+                // Create memory, timing how long it takes to train or load. **NOTE** counters include
+                // threads created while training once they exit, but not persistent OpenMP worker threads
+                std::unique_ptr<PerfCounters> trainingPerfCounters(collectPerfCounters ? new PerfCounters(true) : nullptr);
+                const auto trainingStart = std::chrono::steady_clock::now();
+                if(trainingPerfCounters) {
+                    trainingPerfCounters->enable();
+                }
+                const auto memory = createMemory(m, getImageSize(v), *routes[routeName][v], memoryParameters);
+                if(trainingPerfCounters) {
+                    trainingPerfCounters->disable();
+                }
+                const std::chrono::duration<double> trainingTime = std::chrono::steady_clock::now() - trainingStart;
+
+                // If grid outputs are required, open CSV and render route onto grid image
+                const std::string outputSuffix = routeName + "_" + m + "_" + v;
+                std::ofstream gridCSV;
+                cv::Mat gridImage;
+                if(!skipGridOutputs) {
+                    gridCSV.open((filesystem::path(outputDirectory) / ("output_" + outputSuffix + ".csv")).str());
+                    memory->writeCSVHeader(gridCSV);
+                    gridCSV << std::endl;
+
+                    gridImage.create(grid.getRenderSize(), CV_8UC3);
+                    gridImage.setTo(cv::Scalar::all(0));
+                    cv::polylines(gridImage, routePointMats[routeName][v], false, CV_RGB(64, 64, 64));
+                    cv::polylines(gridImage, decimatedRoutePointMats[routeName][v], false, CV_RGB(255, 255, 255));
+                }
+
+                // Evaluate grid
+                PerfCounterValues testPerfCounters;
+                const auto evaluationStart = std::chrono::steady_clock::now();
+                const degree_t rmse = evaluateGrid(grid, gridNearestPoints[routeName][v], *memory, workerPool,
+                                                   skipGridOutputs ? nullptr : &gridCSV,
+                                                   skipGridOutputs ? nullptr : &gridImage,
+                                                   nullptr, collectPerfCounters ? &testPerfCounters : nullptr);
+                const std::chrono::duration<double> evaluationTime = std::chrono::steady_clock::now() - evaluationStart;
+
+                if(!skipGridOutputs) {
+                    cv::imwrite((filesystem::path(outputDirectory) / ("grid_image_" + outputSuffix + ".png")).str(), gridImage);
+                }
+
+                // Write CSV line to output
+                std::cout << "RMSE:" << rmse << std::endl;
+                outputCSV << routeName << ", " << m << ", " << v << ", " << rmse << ", "
+                    << trainingTime.count() << ", " << evaluationTime.count() << std::endl;
+
+                // Write performance counters for training and testing
+                if(collectPerfCounters) {
+                    perfCountersCSV << routeName << ", " << m << ", " << v << ", training, " << trainingTime.count() << ", ";
+                    trainingPerfCounters->read().writeCSV(perfCountersCSV);
+                    perfCountersCSV << std::endl;
+
+                    perfCountersCSV << routeName << ", " << m << ", " << v << ", test, " << evaluationTime.count() << ", ";
+                    testPerfCounters.writeCSV(perfCountersCSV);
+                    perfCountersCSV << std::endl;
+                }
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
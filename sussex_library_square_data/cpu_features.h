@@ -0,0 +1,38 @@
+#pragma once
+
+// Standard C includes
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+// SIMD kernels are compiled for the instruction sets they use with SIMD_TARGET and only called if the CPU supports
+// them, so a default build uses them on any CPU which does rather than falling back to scalar code
+#define SIMD_X86
+#define SIMD_TARGET(TARGET) __attribute__((target(TARGET)))
+#endif
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+#ifdef SIMD_X86
+// Does CPU support AVX2? If this is known at compile time e.g. when building with -march=native, no check is made
+inline bool hasAVX2()
+{
+#ifdef __AVX2__
+    return true;
+#else
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#endif
+}
+
+// Does CPU support AVX2, F16C and FMA?
+inline bool hasAVX2F16CFMA()
+{
+#if defined(__AVX2__) && defined(__F16C__) && defined(__FMA__)
+    return true;
+#else
+    static const bool avx2F16CFMA = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c") && __builtin_cpu_supports("fma");
+    return avx2F16CFMA;
+#endif
+}
+#endif  // SIMD_X86
@@ -0,0 +1,224 @@
+#include "grid_evaluation.h"
+
+// Standard C++ includes
+#include <sstream>
+#include <stdexcept>
+
+// BoB robotics includes
+#include "common/assert.h"
+
+#include "profiler.h"
+
+using namespace BoBRobotics;
+using namespace units::literals;
+using namespace units::length;
+using namespace units::angle;
+using namespace units::math;
+using namespace units::solid_angle;
+
+//------------------------------------------------------------------------
+// ImageGrid
+//------------------------------------------------------------------------
+ImageGrid::ImageGrid(const filesystem::path &gridPath, const cv::Size &imSize)
+:   m_Database(gridPath), m_ImageSize(imSize)
+{
+    BOB_ASSERT(m_Database.isGrid());
+    BOB_ASSERT(m_Database.hasMetadata());
+
+    // Read grid dimensions from meta data
+    std::vector<double> size, seperationMM;
+    m_Database.getMetadata()["grid"]["separationMM"] >> seperationMM;
+    m_Database.getMetadata()["grid"]["size"] >> size;
+    BOB_ASSERT(size.size() == 3);
+    BOB_ASSERT(seperationMM.size() == 3);
+
+    std::cout << size[0] << "x" << size[1] << " grid with " << seperationMM[0] << "x" << seperationMM[1] << "mm squares" << std::endl;
+
+    m_RenderSize = cv::Size((int)std::round(size[0] * seperationMM[0] * 0.1),
+                            (int)std::round(size[1] * seperationMM[1] * 0.1));
+
+    // Get positions of grid points
+    m_Points.reserve(m_Database.size());
+    for(const auto &g : m_Database) {
+        const centimeter_t x = g.position[0];
+        const centimeter_t y = g.position[1];
+        m_Points.emplace_back(x.value(), y.value());
+    }
+}
+//------------------------------------------------------------------------
+void ImageGrid::loadSnapshots(const std::vector<size_t> &indices, unsigned int numThreads)
+{
+    m_Snapshots.reset(new SnapshotCache(m_Database, m_ImageSize, indices, numThreads));
+}
+//------------------------------------------------------------------------
+const SnapshotCache &ImageGrid::getSnapshots() const
+{
+    BOB_ASSERT(m_Snapshots);
+    return *m_Snapshots;
+}
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+std::vector<NearestRoutePoint> findNearestRoutePoints(const std::string &routeLookup, const std::vector<cv::Point2f> &decimatedRoutePoints,
+                                                      const ImageGrid &grid, const filesystem::path &routePath, double decimateDistance)
+{
+    Profiler::ScopedTimer timer("Nearest route lookup");
+
+    std::vector<NearestRoutePoint> nearestPoints;
+    nearestPoints.reserve(grid.size());
+    if(routeLookup == "Linear") {
+        for(const auto &p : grid.getPoints()) {
+            nearestPoints.push_back(getNearestPointOnRoute(p, decimatedRoutePoints));
+        }
+    }
+    else if(routeLookup == "SegmentIndex") {
+        const RouteSegmentIndex routeSegmentIndex(decimatedRoutePoints);
+        std::cout << "Built route segment index with " << routeSegmentIndex.getCellSize() << "cm cells" << std::endl;
+        for(const auto &p : grid.getPoints()) {
+            nearestPoints.push_back(routeSegmentIndex.getNearestPoint(p));
+        }
+    }
+    else if(routeLookup == "Raster") {
+        // Cache raster alongside route, keyed by decimate distance
+        std::ostringstream rasterFilename;
+        rasterFilename << "route_raster_" << decimateDistance << "cm.bin";
+        const RouteRaster routeRaster(decimatedRoutePoints, grid.getRenderSize(), routePath / rasterFilename.str());
+        for(const auto &p : grid.getPoints()) {
+            nearestPoints.push_back(routeRaster.getNearestPoint(p));
+        }
+    }
+    else if(routeLookup == "SIMD") {
+        const RouteSegments routeSegments(decimatedRoutePoints);
+        routeSegments.getNearestPoints(grid.getPoints(), nearestPoints);
+    }
+    else {
+        throw std::runtime_error("Route lookup '" + routeLookup + "' not supported");
+    }
+    return nearestPoints;
+}
+//------------------------------------------------------------------------
+bool isWithinROI(const NearestRoutePoint &nearestRoutePoint)
+{
+    return std::get<0>(nearestRoutePoint) < 4_m;
+}
+//------------------------------------------------------------------------
+std::vector<size_t> getROIIndices(const std::vector<NearestRoutePoint> &nearestRoutePoints)
+{
+    std::vector<size_t> indices;
+    for(size_t i = 0; i < nearestRoutePoints.size(); i++) {
+        if(isWithinROI(nearestRoutePoints[i])) {
+            indices.push_back(i);
+        }
+    }
+    return indices;
+}
+//------------------------------------------------------------------------
+degree_t evaluateGrid(const ImageGrid &grid, const std::vector<NearestRoutePoint> &nearestRoutePoints,
+                      const MemoryBase &memory, WorkerPool &workerPool,
+                      std::ostream *outputCSV, cv::Mat *gridImage, const std::function<void()> &onCommit,
+                      PerfCounterValues *testCounters)
+{
+    BOB_ASSERT(nearestRoutePoints.size() == grid.size());
+
+    // Give each thread its own copy of memory - memories store the result of the last test and use scratch buffers.
+    // If memory's results depend on the order points are tested in, every point is instead tested in grid order, when
+    // it is committed, by a single copy of memory. If required, each thread also opens its own performance counters
+    // when it tests its first grid point
+    const unsigned int numThreads = workerPool.getNumThreads();
+    const bool orderDependent = memory.isOrderDependent();
+    std::vector<std::unique_ptr<MemoryBase>> memories;
+    for(unsigned int t = 0; t < (orderDependent ? 1 : numThreads); t++) {
+        memories.push_back(memory.clone());
+    }
+    std::vector<std::unique_ptr<PerfCounters>> perfCounters(numThreads);
+    auto getMemory = [&](unsigned int t) -> MemoryBase& { return *memories[orderDependent ? 0 : t]; };
+
+    auto testGridPoint =
+        [&](size_t i, unsigned int t)
+        {
+            // If snapshot is within R.O.I., test resized snapshot
+            const auto &nearestPoint = nearestRoutePoints[i];
+            if(isWithinROI(nearestPoint)) {
+                Profiler::ScopedTimer timer("Grid point test");
+                if(testCounters != nullptr && !perfCounters[t]) {
+                    perfCounters[t].reset(new PerfCounters());
+                }
+                if(perfCounters[t]) {
+                    perfCounters[t]->enable();
+                }
+                getMemory(t).test(grid.getSnapshots()[i], grid.getDatabase()[i].heading, std::get<3>(nearestPoint));
+                if(perfCounters[t]) {
+                    perfCounters[t]->disable();
+                }
+            }
+        };
+
+    size_t numGridPointsWithinROI = 0;
+    degree_squared_t sumSquareError = 0_sq_deg;
+    workerPool.runOrdered(grid.size(),
+                          [&](size_t i, unsigned int t)
+                          {
+                              if(!orderDependent) {
+                                  testGridPoint(i, t);
+                              }
+                          },
+                          [&](size_t i, unsigned int t)
+                          {
+                              if(orderDependent) {
+                                  testGridPoint(i, t);
+                              }
+
+                              // If snapshot is within R.O.I.
+                              const auto &nearestPoint = nearestRoutePoints[i];
+                              if(isWithinROI(nearestPoint)) {
+                                  MemoryBase &threadMemory = getMemory(t);
+                                  const auto &g = grid.getDatabase()[i];
+                                  const centimeter_t x = g.position[0];
+                                  const centimeter_t y = g.position[1];
+
+                                  // Increment count
+                                  numGridPointsWithinROI++;
+
+                                  // Get magnitude of shortest angle between route and headig
+                                  const degree_t angularError = shortestAngleBetween(threadMemory.getBestHeading(), std::get<3>(nearestPoint));
+
+                                  // Add to sum square error
+                                  sumSquareError += (angularError * angularError);
+
+                                  if(gridImage != nullptr) {
+                                      Profiler::ScopedTimer timer("Rendering");
+
+                                      // Draw arrow showing vector field
+                                      const centimeter_t xEnd = x + (60_cm * threadMemory.getVectorLength() * cos(threadMemory.getBestHeading()));
+                                      const centimeter_t yEnd = y + (60_cm * threadMemory.getVectorLength() * sin(threadMemory.getBestHeading()));
+                                      cv::arrowedLine(*gridImage, cv::Point(x.value(), y.value()), cv::Point(xEnd.value(), yEnd.value()),
+                                                      CV_RGB(0, 0, 255));
+
+                                      // Perform any memory-specific additional rendering
+                                      threadMemory.render(*gridImage, x, y);
+                                  }
+
+                                  // Write CSV line
+                                  if(outputCSV != nullptr) {
+                                      Profiler::ScopedTimer timer("CSV writing");
+                                      threadMemory.writeCSVLine(*outputCSV, x, y, angularError);
+                                      *outputCSV << std::endl;
+                                  }
+
+                                  if(onCommit) {
+                                      Profiler::ScopedTimer timer("Grid point commit callback");
+                                      onCommit();
+                                  }
+                              }
+                          });
+
+    // Add each thread's counts to total
+    for(const auto &p : perfCounters) {
+        if(p) {
+            *testCounters += p->read();
+        }
+    }
+
+    return degree_t(sqrt(sumSquareError / (double)numGridPointsWithinROI));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+// Standard C++ includes
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// BoB robotics 3rd party includes
+#include "third_party/path.h"
+#include "third_party/units.h"
+
+// BoB robotics includes
+#include "navigation/image_database.h"
+
+#include "memory.h"
+#include "perf_counters.h"
+#include "route.h"
+#include "snapshot_cache.h"
+#include "worker_pool.h"
+
+//------------------------------------------------------------------------
+// ImageGrid
+//------------------------------------------------------------------------
+// Grid of images, loaded once, with the positions of its points and, once loadSnapshots is called,
+// the snapshots of the grid points which will be tested resized for testing
+class ImageGrid
+{
+public:
+    ImageGrid(const filesystem::path &gridPath, const cv::Size &imSize);
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    // Load resized snapshots of grid points with indices, which must be in ascending order. If the
+    // snapshot cache needs building, images are loaded and resized using numThreads threads
+    void loadSnapshots(const std::vector<size_t> &indices, unsigned int numThreads = 1);
+
+    const BoBRobotics::Navigation::ImageDatabase &getDatabase() const{ return m_Database; }
+    const SnapshotCache &getSnapshots() const;
+    const std::vector<cv::Point2f> &getPoints() const{ return m_Points; }
+    size_t size() const{ return m_Points.size(); }
+
+    // Size of image to render grid into, with one pixel per cm
+    const cv::Size &getRenderSize() const{ return m_RenderSize; }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const BoBRobotics::Navigation::ImageDatabase m_Database;
+    const cv::Size m_ImageSize;
+    std::unique_ptr<SnapshotCache> m_Snapshots;
+    std::vector<cv::Point2f> m_Points;
+    cv::Size m_RenderSize;
+};
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+// Find nearest point on decimated route to every grid point using the named route lookup. If routeLookup is "Raster",
+// the raster is cached in routePath, keyed by decimate distance
+std::vector<NearestRoutePoint> findNearestRoutePoints(const std::string &routeLookup, const std::vector<cv::Point2f> &decimatedRoutePoints,
+                                                      const ImageGrid &grid, const filesystem::path &routePath, double decimateDistance);
+
+// Is grid point, with nearest route point, within the R.O.I. of the route which is tested
+bool isWithinROI(const NearestRoutePoint &nearestRoutePoint);
+
+// Get indices of grid points within R.O.I. of route in ascending order
+std::vector<size_t> getROIIndices(const std::vector<NearestRoutePoint> &nearestRoutePoints);
+
+// Test every grid point within R.O.I. of route, whose snapshots must have been loaded, on the threads of workerPool, each testing
+// with its own copy of memory - unless memory is order dependent, in which case points are tested in grid order by one copy.
+// If outputCSV or gridImage are provided, a CSV line is written and vector field arrow rendered for each grid point. Results
+// are 'committed' strictly in grid order so outputs are identical to a serial run and onCommit, if provided, is called after
+// each grid point is committed. If testCounters is provided, hardware performance counters are collected around each memory
+// test on every thread and added to it. Returns RMS angular error between best headings and route
+units::angle::degree_t evaluateGrid(const ImageGrid &grid, const std::vector<NearestRoutePoint> &nearestRoutePoints,
+                                    const MemoryBase &memory, WorkerPool &workerPool,
+                                    std::ostream *outputCSV = nullptr, cv::Mat *gridImage = nullptr,
+                                    const std::function<void()> &onCommit = nullptr,
+                                    PerfCounterValues *testCounters = nullptr);
@@ -0,0 +1,50 @@
+#pragma once
+
+// Standard C++ includes
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//------------------------------------------------------------------------
+// FNV1AHash
+//------------------------------------------------------------------------
+// Incremental 64-bit FNV-1a hash, used for keying and validating on-disk caches
+class FNV1AHash
+{
+public:
+    FNV1AHash() : m_Hash(14695981039346656037ull)
+    {
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    void update(const void *data, size_t size)
+    {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t*>(data);
+        for(size_t i = 0; i < size; i++) {
+            m_Hash ^= bytes[i];
+            m_Hash *= 1099511628211ull;
+        }
+    }
+
+    void update(const std::string &string)
+    {
+        update(string.size());
+        update(string.data(), string.size());
+    }
+
+    template<typename T>
+    void update(const T &value)
+    {
+        update(&value, sizeof(T));
+    }
+
+    uint64_t get() const{ return m_Hash; }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    uint64_t m_Hash;
+};
@@ -0,0 +1,184 @@
+#include "hnsw_index.h"
+
+// Standard C++ includes
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+// BoB robotics includes
+#include "common/assert.h"
+
+#include "sad.h"
+
+//------------------------------------------------------------------------
+// HNSWIndex
+//------------------------------------------------------------------------
+HNSWIndex::HNSWIndex(size_t dimensions, size_t maxConnections, size_t efConstruction, unsigned int seed)
+:   m_Dimensions(dimensions), m_MaxConnections(maxConnections), m_MaxConnections0(2 * maxConnections),
+    m_EFConstruction(std::max(efConstruction, maxConnections)), m_LevelMultiplier(1.0 / std::log((double)maxConnections)),
+    m_RNG(seed), m_EntryPoint(0), m_TopLayer(0)
+{
+    BOB_ASSERT(maxConnections > 1);
+}
+//------------------------------------------------------------------------
+void HNSWIndex::add(const uint8_t *vector)
+{
+    // Pick layer to insert node in from exponentially decaying distribution
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const size_t layer = (size_t)std::floor(-std::log(1.0 - uniform(m_RNG)) * m_LevelMultiplier);
+
+    // Add vector and empty neighbour lists
+    const size_t node = size();
+    m_Vectors.insert(m_Vectors.end(), vector, vector + m_Dimensions);
+    m_Neighbours.emplace_back(layer + 1);
+
+    // If this is the first node, make it the entry point
+    if(node == 0) {
+        m_EntryPoint = node;
+        m_TopLayer = layer;
+        return;
+    }
+
+    // Greedily descend through layers above the new node's
+    std::vector<Neighbour> entryPoints{Neighbour(getDistance(vector, m_EntryPoint), m_EntryPoint)};
+    for(size_t l = m_TopLayer; l > layer; l--) {
+        entryPoints = searchLayer(vector, entryPoints, 1, l, m_InsertVisitMarks);
+    }
+
+    // Connect node to its neighbours in each of its layers
+    for(size_t l = std::min(layer, m_TopLayer) + 1; l-- > 0;) {
+        entryPoints = searchLayer(vector, entryPoints, m_EFConstruction, l, m_InsertVisitMarks);
+        m_Neighbours[node][l] = selectNeighbours(entryPoints, m_MaxConnections);
+
+        // Add reverse connections, pruning neighbours' connections if they have too many
+        const size_t maxConnections = (l == 0) ? m_MaxConnections0 : m_MaxConnections;
+        for(size_t n : m_Neighbours[node][l]) {
+            auto &neighbourConnections = m_Neighbours[n][l];
+            neighbourConnections.push_back(node);
+            if(neighbourConnections.size() > maxConnections) {
+                std::vector<Neighbour> candidates;
+                candidates.reserve(neighbourConnections.size());
+                for(size_t c : neighbourConnections) {
+                    candidates.emplace_back(getDistance(getVector(n), c), c);
+                }
+                std::sort(candidates.begin(), candidates.end());
+                neighbourConnections = selectNeighbours(candidates, maxConnections);
+            }
+        }
+    }
+
+    // If node reaches above current top layer, make it the entry point
+    if(layer > m_TopLayer) {
+        m_EntryPoint = node;
+        m_TopLayer = layer;
+    }
+}
+//------------------------------------------------------------------------
+std::vector<HNSWIndex::Neighbour> HNSWIndex::search(const uint8_t *query, size_t k, size_t ef, VisitMarks &visitMarks) const
+{
+    if(size() == 0) {
+        return {};
+    }
+
+    // Greedily descend through upper layers
+    std::vector<Neighbour> entryPoints{Neighbour(getDistance(query, m_EntryPoint), m_EntryPoint)};
+    for(size_t l = m_TopLayer; l > 0; l--) {
+        entryPoints = searchLayer(query, entryPoints, 1, l, visitMarks);
+    }
+
+    // Search layer 0 and return k nearest
+    auto nearest = searchLayer(query, entryPoints, std::max(ef, k), 0, visitMarks);
+    if(nearest.size() > k) {
+        nearest.resize(k);
+    }
+    return nearest;
+}
+//------------------------------------------------------------------------
+uint32_t HNSWIndex::getDistance(const uint8_t *query, size_t index) const
+{
+    return sumAbsoluteDifferences(query, getVector(index), m_Dimensions);
+}
+//------------------------------------------------------------------------
+std::vector<HNSWIndex::Neighbour> HNSWIndex::searchLayer(const uint8_t *query, const std::vector<Neighbour> &entryPoints,
+                                                         size_t ef, size_t layer, VisitMarks &visitMarks) const
+{
+    // Start new visit - if tag wraps, clear marks. Marks for nodes added since last visit start cleared
+    if(++visitMarks.tag == 0) {
+        std::fill(visitMarks.marks.begin(), visitMarks.marks.end(), 0);
+        visitMarks.tag = 1;
+    }
+    visitMarks.marks.resize(size(), 0);
+
+    // Min-heap of candidates to expand and max-heap of best ef results found so far
+    std::priority_queue<Neighbour, std::vector<Neighbour>, std::greater<Neighbour>> candidates;
+    std::priority_queue<Neighbour> results;
+    for(const auto &e : entryPoints) {
+        visitMarks.marks[e.second] = visitMarks.tag;
+        candidates.push(e);
+        results.push(e);
+    }
+    while(results.size() > ef) {
+        results.pop();
+    }
+
+    while(!candidates.empty()) {
+        // Stop once closest remaining candidate is further than all results
+        const Neighbour current = candidates.top();
+        if(results.size() >= ef && current.first > results.top().first) {
+            break;
+        }
+        candidates.pop();
+
+        // Add unvisited neighbours which are closer than the furthest result
+        for(size_t n : m_Neighbours[current.second][layer]) {
+            if(visitMarks.marks[n] != visitMarks.tag) {
+                visitMarks.marks[n] = visitMarks.tag;
+
+                const Neighbour neighbour(getDistance(query, n), n);
+                if(results.size() < ef || neighbour < results.top()) {
+                    candidates.push(neighbour);
+                    results.push(neighbour);
+                    if(results.size() > ef) {
+                        results.pop();
+                    }
+                }
+            }
+        }
+    }
+
+    // Copy results out in ascending order of distance
+    std::vector<Neighbour> nearest(results.size());
+    for(auto n = nearest.rbegin(); n != nearest.rend(); ++n) {
+        *n = results.top();
+        results.pop();
+    }
+    return nearest;
+}
+//------------------------------------------------------------------------
+std::vector<size_t> HNSWIndex::selectNeighbours(const std::vector<Neighbour> &candidates, size_t maxConnections) const
+{
+    std::vector<size_t> selected;
+    std::vector<size_t> discarded;
+    for(const auto &c : candidates) {
+        if(selected.size() == maxConnections) {
+            break;
+        }
+
+        // Keep candidate if it's closer to the query than to any already selected neighbour
+        const bool diverse = std::none_of(selected.cbegin(), selected.cend(),
+                                          [&c, this](size_t s){ return getDistance(getVector(c.second), s) < c.first; });
+        if(diverse) {
+            selected.push_back(c.second);
+        }
+        else {
+            discarded.push_back(c.second);
+        }
+    }
+
+    // Fill any remaining connections with the closest discarded candidates
+    for(size_t i = 0; i < discarded.size() && selected.size() < maxConnections; i++) {
+        selected.push_back(discarded[i]);
+    }
+    return selected;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+// Standard C++ includes
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+//------------------------------------------------------------------------
+// HNSWIndex
+//------------------------------------------------------------------------
+// Hierarchical Navigable Small World graph (Malkov & Yashunin, 2018) for approximate nearest neighbour search over
+// 8-bit vectors using the sum of absolute differences as the distance. Each vector is inserted into a randomly
+// chosen number of layers; each layer is a proximity graph with a bounded number of connections per node.
+// Searches descend greedily through the sparse upper layers and then run a beam search of width ef in layer 0,
+// so query cost grows roughly logarithmically with the number of vectors. Level assignment uses a seeded RNG
+// so indices built from the same vectors in the same order are identical
+class HNSWIndex
+{
+public:
+    // Distance to vector and index of vector
+    using Neighbour = std::pair<uint32_t, size_t>;
+
+    // Marks recording which nodes a search has visited - a node has been visited if its mark equals tag.
+    // Searches on different threads can share an index but each need their own marks
+    struct VisitMarks
+    {
+        std::vector<unsigned int> marks;
+        unsigned int tag = 0;
+    };
+
+    HNSWIndex(size_t dimensions, size_t maxConnections = 16, size_t efConstruction = 100, unsigned int seed = 0);
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    // Add vector of dimensions elements to index
+    void add(const uint8_t *vector);
+
+    // Find (approximately) the k nearest vectors to query, sorted by distance. ef is the width of the
+    // beam used to search layer 0 - larger values are slower but more accurate
+    std::vector<Neighbour> search(const uint8_t *query, size_t k, size_t ef, VisitMarks &visitMarks) const;
+
+    size_t size() const{ return m_Neighbours.size(); }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    const uint8_t *getVector(size_t index) const{ return &m_Vectors[index * m_Dimensions]; }
+    uint32_t getDistance(const uint8_t *query, size_t index) const;
+
+    // Beam search of width ef through layer, starting from entryPoints. Returns neighbours sorted by distance
+    std::vector<Neighbour> searchLayer(const uint8_t *query, const std::vector<Neighbour> &entryPoints,
+                                       size_t ef, size_t layer, VisitMarks &visitMarks) const;
+
+    // Select up to maxConnections neighbours from candidates (sorted by distance), preferring ones which
+    // aren't closer to an already selected neighbour than to the query so the graph stays well-connected
+    std::vector<size_t> selectNeighbours(const std::vector<Neighbour> &candidates, size_t maxConnections) const;
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const size_t m_Dimensions;
+
+    // Maximum number of connections per node in upper layers and layer 0
+    const size_t m_MaxConnections;
+    const size_t m_MaxConnections0;
+
+    // Width of beam used when searching for neighbours of inserted vectors
+    const size_t m_EFConstruction;
+
+    // Normalisation factor for level assignment
+    const double m_LevelMultiplier;
+    std::mt19937 m_RNG;
+
+    // Vectors stored contiguously
+    std::vector<uint8_t> m_Vectors;
+
+    // Neighbours of each node in each of the layers it belongs to, indexed [node][layer]
+    std::vector<std::vector<std::vector<size_t>>> m_Neighbours;
+
+    // Node in top layer where searches start
+    size_t m_EntryPoint;
+    size_t m_TopLayer;
+
+    // Visit marks used when inserting vectors
+    VisitMarks m_InsertVisitMarks;
+};
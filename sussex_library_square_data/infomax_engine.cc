@@ -0,0 +1,398 @@
+#include "infomax_engine.h"
+
+// Standard C++ includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+// BoB robotics includes
+#include "common/assert.h"
+
+#include "quantised_dot.h"
+
+using namespace BoBRobotics;
+
+//------------------------------------------------------------------------
+// Anonymous namespace
+//------------------------------------------------------------------------
+namespace
+{
+// Build each rotation of image within columnRanges, one after another, returning number of rotations
+int buildRotatedImages(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges, std::vector<uint8_t> &inputs)
+{
+    BOB_ASSERT(image.type() == CV_8UC1);
+
+    int numRotations = 0;
+    for(const auto &r : columnRanges) {
+        numRotations += r.second - r.first;
+    }
+
+    const int width = image.cols;
+    const size_t area = (size_t)image.cols * (size_t)image.rows;
+    inputs.resize(area * numRotations);
+    uint8_t *input = inputs.data();
+    for(const auto &r : columnRanges) {
+        for(int c = r.first; c < r.second; c++) {
+            for(int y = 0; y < image.rows; y++) {
+                const uint8_t *row = image.ptr<uint8_t>(y);
+                std::copy(row + c, row + width, input);
+                std::copy(row, row + c, input + width - c);
+                input += width;
+            }
+        }
+    }
+    return numRotations;
+}
+
+// Size of the tile of weights and the tile of rotated images worked on together - both fit in L2 cache
+const size_t s_TileBytes = 128 * 1024;
+
+// Visit every pair of hidden unit and rotation in tiles of units and rotations sized so both tiles fit in L2 cache
+// together. Each tile of weights is then loaded from memory once and dotted with a tile of rotated images at a time,
+// so rotated images are re-read once per tile of units rather than once per unit
+template<typename F>
+void visitTiled(int numUnits, int numRotations, size_t unitBytes, size_t rotationBytes, F visit)
+{
+    const int unitsPerTile = std::max(1, (int)(s_TileBytes / unitBytes));
+    const int rotationsPerTile = std::max(1, (int)(s_TileBytes / rotationBytes));
+    for(int h0 = 0; h0 < numUnits; h0 += unitsPerTile) {
+        const int hEnd = std::min(numUnits, h0 + unitsPerTile);
+        for(int i0 = 0; i0 < numRotations; i0 += rotationsPerTile) {
+            const int iEnd = std::min(numRotations, i0 + rotationsPerTile);
+            for(int h = h0; h < hEnd; h++) {
+                for(int i = i0; i < iEnd; i++) {
+                    visit(h, i);
+                }
+            }
+        }
+    }
+}
+
+// Copy familiarity of each rotation into differences, indexed by column
+void scatterFamiliarity(const std::vector<float> &familiarity, const std::vector<ColumnRange> &columnRanges,
+                        int width, std::vector<float> &differences)
+{
+    differences.assign(width, std::numeric_limits<float>::max());
+    int i = 0;
+    for(const auto &r : columnRanges) {
+        for(int c = r.first; c < r.second; c++, i++) {
+            differences[c] = familiarity[i];
+        }
+    }
+}
+}   // Anonymous namespace
+
+//------------------------------------------------------------------------
+// InfoMaxEngine
+//------------------------------------------------------------------------
+InfoMaxEngine::InfoMaxEngine(const cv::Size &imSize, const InfoMaxWeights &weights)
+:   m_ImageSize(imSize), m_Weights(weights)
+{
+    BOB_ASSERT(weights.getWeights().cols() == imSize.area());
+}
+//------------------------------------------------------------------------
+InfoMaxEngine::~InfoMaxEngine()
+{
+}
+//------------------------------------------------------------------------
+void InfoMaxEngine::calculateImageDifferences(const cv::Mat &image, std::vector<float> &differences) const
+{
+    calculateImageDifferences(image, {ColumnRange(0, getImageSize().width)}, differences);
+}
+
+//------------------------------------------------------------------------
+// InfoMaxEngineDirect
+//------------------------------------------------------------------------
+InfoMaxEngineDirect::InfoMaxEngineDirect(const cv::Size &imSize, const InfoMaxWeights &weights)
+:   InfoMaxEngine(imSize, weights), m_InfoMax(imSize, weights.getWeights())
+{
+}
+//------------------------------------------------------------------------
+void InfoMaxEngineDirect::calculateImageDifferences(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                                    std::vector<float> &differences) const
+{
+    // If all rotations are required, use InfoMaxRotater directly
+    if(columnRanges.size() == 1 && columnRanges.front() == ColumnRange(0, getImageSize().width)) {
+        differences = m_InfoMax.getImageDifferences(image);
+    }
+    // Otherwise, test rotated images in the same way as InfoMaxRotater
+    else {
+        differences.assign(getImageSize().width, std::numeric_limits<float>::max());
+        for(const auto &r : columnRanges) {
+            for(int c = r.first; c < r.second; c++) {
+                rollImage(image, m_ScratchRotatedImage, c);
+                differences[c] = m_InfoMax.test(m_ScratchRotatedImage);
+            }
+        }
+    }
+}
+//------------------------------------------------------------------------
+std::unique_ptr<InfoMaxEngine> InfoMaxEngineDirect::clone() const
+{
+    return std::unique_ptr<InfoMaxEngine>(new InfoMaxEngineDirect(*this));
+}
+
+//------------------------------------------------------------------------
+// InfoMaxEngineGEMM
+//------------------------------------------------------------------------
+InfoMaxEngineGEMM::InfoMaxEngineGEMM(const cv::Size &imSize, const InfoMaxWeights &weights)
+:   InfoMaxEngine(imSize, weights)
+{
+}
+//------------------------------------------------------------------------
+void InfoMaxEngineGEMM::calculateImageDifferences(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                                  std::vector<float> &differences) const
+{
+    BOB_ASSERT(image.type() == CV_8UC1);
+    BOB_ASSERT(image.size() == getImageSize());
+
+    // Count rotations
+    int numRotations = 0;
+    for(const auto &r : columnRanges) {
+        numRotations += r.second - r.first;
+    }
+
+    // Build matrix with each required rotation of image, scaled to [0, 1], in each column
+    const int width = getImageSize().width;
+    m_ScratchInputs.resize(getImageSize().area(), numRotations);
+    int i = 0;
+    for(const auto &r : columnRanges) {
+        for(int c = r.first; c < r.second; c++, i++) {
+            float *input = m_ScratchInputs.col(i).data();
+            for(int y = 0; y < getImageSize().height; y++) {
+                const uint8_t *row = image.ptr<uint8_t>(y);
+                for(int x = 0; x < width; x++) {
+                    input[(y * width) + x] = (float)row[(x + c) % width] / 255.0f;
+                }
+            }
+        }
+    }
+
+    // Calculate activations for all rotations with one matrix-matrix product
+    m_ScratchActivations.noalias() = getWeights() * m_ScratchInputs;
+
+    // Familiarity of each rotation is sum of absolute activations
+    differences.assign(width, std::numeric_limits<float>::max());
+    i = 0;
+    for(const auto &r : columnRanges) {
+        for(int c = r.first; c < r.second; c++, i++) {
+            differences[c] = m_ScratchActivations.col(i).cwiseAbs().sum();
+        }
+    }
+}
+//------------------------------------------------------------------------
+std::unique_ptr<InfoMaxEngine> InfoMaxEngineGEMM::clone() const
+{
+    return std::unique_ptr<InfoMaxEngine>(new InfoMaxEngineGEMM(*this));
+}
+
+//------------------------------------------------------------------------
+// InfoMaxEngineFP16
+//------------------------------------------------------------------------
+InfoMaxEngineFP16::InfoMaxEngineFP16(const cv::Size &imSize, const InfoMaxWeights &weights)
+:   InfoMaxEngine(imSize, weights)
+{
+    // Convert weights to half precision in row-major order
+    const auto &w = getWeights();
+    auto halfWeights = std::make_shared<std::vector<uint16_t>>(w.size());
+    auto half = halfWeights->begin();
+    for(int h = 0; h < w.rows(); h++) {
+        for(int i = 0; i < w.cols(); i++) {
+            *half++ = floatToHalf(w(h, i));
+        }
+    }
+    m_HalfWeights = halfWeights;
+}
+//------------------------------------------------------------------------
+void InfoMaxEngineFP16::calculateImageDifferences(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                                  std::vector<float> &differences) const
+{
+    BOB_ASSERT(image.size() == getImageSize());
+    const int numRotations = buildRotatedImages(image, columnRanges, m_ScratchInputs);
+
+    // Accumulate absolute activation of every hidden unit for every rotation, working through them in tiles
+    const size_t area = getImageSize().area();
+    m_ScratchFamiliarity.assign(numRotations, 0.0f);
+    visitTiled((int)getWeights().rows(), numRotations, area * sizeof(uint16_t), area,
+               [area, this](int h, int i)
+               {
+                   m_ScratchFamiliarity[i] += std::fabs(dotHalf(&(*m_HalfWeights)[h * area], &m_ScratchInputs[i * area], area));
+               });
+
+    // Apply pixel scale
+    for(float &f : m_ScratchFamiliarity) {
+        f /= 255.0f;
+    }
+    scatterFamiliarity(m_ScratchFamiliarity, columnRanges, getImageSize().width, differences);
+}
+//------------------------------------------------------------------------
+std::unique_ptr<InfoMaxEngine> InfoMaxEngineFP16::clone() const
+{
+    return std::unique_ptr<InfoMaxEngine>(new InfoMaxEngineFP16(*this));
+}
+
+//------------------------------------------------------------------------
+// InfoMaxEngineInt8
+//------------------------------------------------------------------------
+InfoMaxEngineInt8::InfoMaxEngineInt8(const cv::Size &imSize, const InfoMaxWeights &weights)
+:   InfoMaxEngine(imSize, weights)
+{
+    // Integer dot products must not overflow
+    BOB_ASSERT((int64_t)imSize.area() * 127 * 255 <= std::numeric_limits<int32_t>::max());
+
+    // Quantise each row of weights symmetrically, scaling its largest magnitude to 127
+    const auto &w = getWeights();
+    auto quantisedWeights = std::make_shared<std::vector<int8_t>>(w.size());
+    auto rowScales = std::make_shared<std::vector<float>>(w.rows());
+    auto quantised = quantisedWeights->begin();
+    for(int h = 0; h < w.rows(); h++) {
+        const float maxMagnitude = w.row(h).cwiseAbs().maxCoeff();
+        (*rowScales)[h] = maxMagnitude / 127.0f;
+
+        const float inverseScale = (maxMagnitude > 0.0f) ? (127.0f / maxMagnitude) : 0.0f;
+        for(int i = 0; i < w.cols(); i++) {
+            *quantised++ = (int8_t)std::max(-127.0f, std::min(127.0f, std::round(w(h, i) * inverseScale)));
+        }
+    }
+    m_QuantisedWeights = quantisedWeights;
+    m_RowScales = rowScales;
+}
+//------------------------------------------------------------------------
+void InfoMaxEngineInt8::calculateImageDifferences(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                                  std::vector<float> &differences) const
+{
+    BOB_ASSERT(image.size() == getImageSize());
+    const int numRotations = buildRotatedImages(image, columnRanges, m_ScratchInputs);
+
+    // Accumulate absolute activation of every hidden unit for every rotation, working through them in tiles
+    const size_t area = getImageSize().area();
+    m_ScratchFamiliarity.assign(numRotations, 0.0f);
+    visitTiled((int)getWeights().rows(), numRotations, area, area,
+               [area, this](int h, int i)
+               {
+                   const float scale = (*m_RowScales)[h] / 255.0f;
+                   const int32_t activation = dotInt8(&(*m_QuantisedWeights)[h * area], &m_ScratchInputs[i * area], area);
+                   m_ScratchFamiliarity[i] += scale * (float)std::abs(activation);
+               });
+    scatterFamiliarity(m_ScratchFamiliarity, columnRanges, getImageSize().width, differences);
+}
+//------------------------------------------------------------------------
+std::unique_ptr<InfoMaxEngine> InfoMaxEngineInt8::clone() const
+{
+    return std::unique_ptr<InfoMaxEngine>(new InfoMaxEngineInt8(*this));
+}
+
+//------------------------------------------------------------------------
+// InfoMaxEngineFFT
+//------------------------------------------------------------------------
+InfoMaxEngineFFT::InfoMaxEngineFFT(const cv::Size &imSize, const InfoMaxWeights &weights)
+:   InfoMaxEngine(imSize, weights), m_NumFrequencies((imSize.width / 2) + 1)
+{
+    const auto &w = getWeights();
+    const size_t unitSpectrumSize = (size_t)imSize.height * m_NumFrequencies;
+    auto weightSpectra = std::make_shared<std::vector<std::complex<float>>>(w.rows() * unitSpectrumSize);
+
+    // Calculate spectrum of each row of each unit's weights, reshaped to image size
+    cv::Mat unitWeights(imSize, CV_32FC1);
+    cv::Mat unitSpectra;
+    for(int h = 0; h < w.rows(); h++) {
+        for(int y = 0; y < imSize.height; y++) {
+            float *row = unitWeights.ptr<float>(y);
+            for(int x = 0; x < imSize.width; x++) {
+                row[x] = w(h, (y * imSize.width) + x);
+            }
+        }
+        cv::dft(unitWeights, unitSpectra, cv::DFT_ROWS | cv::DFT_COMPLEX_OUTPUT);
+
+        // Copy out non-redundant half
+        std::complex<float> *spectrum = &(*weightSpectra)[h * unitSpectrumSize];
+        for(int y = 0; y < imSize.height; y++) {
+            std::copy_n(unitSpectra.ptr<std::complex<float>>(y), m_NumFrequencies, &spectrum[y * m_NumFrequencies]);
+        }
+    }
+    m_WeightSpectra = weightSpectra;
+}
+//------------------------------------------------------------------------
+void InfoMaxEngineFFT::calculateImageDifferences(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                                 std::vector<float> &differences) const
+{
+    BOB_ASSERT(image.type() == CV_8UC1);
+    BOB_ASSERT(image.size() == getImageSize());
+
+    const int width = getImageSize().width;
+    const int height = getImageSize().height;
+    const int numUnits = (int)getWeights().rows();
+
+    // Calculate spectrum of each row of image, scaled to [0, 1]
+    image.convertTo(m_ScratchFloatImage, CV_32F, 1.0 / 255.0);
+    cv::dft(m_ScratchFloatImage, m_ScratchImageSpectra, cv::DFT_ROWS | cv::DFT_COMPLEX_OUTPUT);
+
+    // For each unit, sum product of image spectrum and conjugate of weight spectrum across rows
+    m_ScratchCrossSpectra.create(numUnits, width, CV_32FC2);
+    for(int h = 0; h < numUnits; h++) {
+        const std::complex<float> *spectrum = &(*m_WeightSpectra)[(size_t)h * height * m_NumFrequencies];
+        std::complex<float> *crossSpectrum = m_ScratchCrossSpectra.ptr<std::complex<float>>(h);
+        std::fill_n(crossSpectrum, m_NumFrequencies, std::complex<float>(0.0f, 0.0f));
+        for(int y = 0; y < height; y++) {
+            const std::complex<float> *imageRow = m_ScratchImageSpectra.ptr<std::complex<float>>(y);
+            const std::complex<float> *weightRow = &spectrum[y * m_NumFrequencies];
+            for(int k = 0; k < m_NumFrequencies; k++) {
+                crossSpectrum[k] += imageRow[k] * std::conj(weightRow[k]);
+            }
+        }
+
+        // Fill in redundant half of spectrum from conjugate symmetry
+        for(int k = m_NumFrequencies; k < width; k++) {
+            crossSpectrum[k] = std::conj(crossSpectrum[width - k]);
+        }
+    }
+
+    // Inverse transform every unit's cross spectrum to get its activation at every rotation
+    cv::dft(m_ScratchCrossSpectra, m_ScratchActivations, cv::DFT_ROWS | cv::DFT_INVERSE | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+
+    // Familiarity of each rotation is sum of absolute activations
+    std::vector<float> familiarity(width, 0.0f);
+    for(int h = 0; h < numUnits; h++) {
+        const float *activations = m_ScratchActivations.ptr<float>(h);
+        for(int c = 0; c < width; c++) {
+            familiarity[c] += std::fabs(activations[c]);
+        }
+    }
+
+    // Copy out rotations within column ranges
+    differences.assign(width, std::numeric_limits<float>::max());
+    for(const auto &r : columnRanges) {
+        std::copy(familiarity.begin() + r.first, familiarity.begin() + r.second, differences.begin() + r.first);
+    }
+}
+//------------------------------------------------------------------------
+std::unique_ptr<InfoMaxEngine> InfoMaxEngineFFT::clone() const
+{
+    return std::unique_ptr<InfoMaxEngine>(new InfoMaxEngineFFT(*this));
+}
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+std::unique_ptr<InfoMaxEngine> createInfoMaxEngine(const std::string &name, const cv::Size &imSize, const InfoMaxWeights &weights)
+{
+    if(name == "Direct") {
+        return std::unique_ptr<InfoMaxEngine>(new InfoMaxEngineDirect(imSize, weights));
+    }
+    else if(name == "GEMM") {
+        return std::unique_ptr<InfoMaxEngine>(new InfoMaxEngineGEMM(imSize, weights));
+    }
+    else if(name == "FP16") {
+        return std::unique_ptr<InfoMaxEngine>(new InfoMaxEngineFP16(imSize, weights));
+    }
+    else if(name == "Int8") {
+        return std::unique_ptr<InfoMaxEngine>(new InfoMaxEngineInt8(imSize, weights));
+    }
+    else if(name == "FFT") {
+        return std::unique_ptr<InfoMaxEngine>(new InfoMaxEngineFFT(imSize, weights));
+    }
+    else {
+        throw std::runtime_error("InfoMax engine '" + name + "' not supported");
+    }
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+// Standard C++ includes
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Eigen
+#include <Eigen/Core>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// BoB robotics includes
+#include "navigation/infomax.h"
+
+#include "infomax_weights.h"
+#include "ridf_engine.h"
+
+//------------------------------------------------------------------------
+// InfoMaxEngine
+//------------------------------------------------------------------------
+// Calculates the familiarity of images at every rotation using trained InfoMax weights. As in BoB robotics'
+// InfoMaxRotater, familiarity is the sum of the absolute hidden unit activations, W * x, where x is the rotated
+// image's pixels, in row-major order, scaled to [0, 1] - lower values are more familiar. Rotations follow the
+// same convention as RIDFEngine
+class InfoMaxEngine
+{
+public:
+    InfoMaxEngine(const cv::Size &imSize, const InfoMaxWeights &weights);
+    virtual ~InfoMaxEngine();
+
+    //------------------------------------------------------------------------
+    // Declared virtuals
+    //------------------------------------------------------------------------
+    // Calculate familiarity at each rotation within columnRanges. Rotations outside of columnRanges may be skipped and are set to float max
+    virtual void calculateImageDifferences(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                           std::vector<float> &differences) const = 0;
+
+    // Create a copy of this engine to use on another thread. The copy shares the weights and any representation
+    // of them made by this engine but has its own scratch buffers
+    virtual std::unique_ptr<InfoMaxEngine> clone() const = 0;
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    // Calculate familiarity at every rotation
+    void calculateImageDifferences(const cv::Mat &image, std::vector<float> &differences) const;
+
+    const cv::Size &getImageSize() const{ return m_ImageSize; }
+    const InfoMaxWeights::MapType &getWeights() const{ return m_Weights.getWeights(); }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const cv::Size m_ImageSize;
+    const InfoMaxWeights &m_Weights;
+};
+
+//------------------------------------------------------------------------
+// InfoMaxEngineDirect
+//------------------------------------------------------------------------
+// Familiarity calculated by BoB robotics' InfoMaxRotater with one matrix-vector product per rotation.
+// **NOTE** InfoMaxRotater owns a copy of the weights so every copy of this engine copies the weights
+class InfoMaxEngineDirect : public InfoMaxEngine
+{
+    using InfoMaxType = BoBRobotics::Navigation::InfoMaxRotater<BoBRobotics::Navigation::InSilicoRotater, float>;
+
+public:
+    InfoMaxEngineDirect(const cv::Size &imSize, const InfoMaxWeights &weights);
+
+    //------------------------------------------------------------------------
+    // InfoMaxEngine virtuals
+    //------------------------------------------------------------------------
+    virtual void calculateImageDifferences(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                           std::vector<float> &differences) const override;
+    virtual std::unique_ptr<InfoMaxEngine> clone() const override;
+
+    using InfoMaxEngine::calculateImageDifferences;
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    InfoMaxType m_InfoMax;
+
+    // Scratch buffer
+    mutable cv::Mat m_ScratchRotatedImage;
+};
+
+//------------------------------------------------------------------------
+// InfoMaxEngineGEMM
+//------------------------------------------------------------------------
+// Familiarity calculated by building every rotation of the image as the columns of one matrix and multiplying it
+// by the (memory-mapped) weights with a single blocked matrix-matrix product. Each weight is loaded once per query
+// rather than once per rotation, so the product is compute rather than bandwidth bound and is multithreaded by
+// Eigen if Eigen::nbThreads() > 1
+class InfoMaxEngineGEMM : public InfoMaxEngine
+{
+public:
+    InfoMaxEngineGEMM(const cv::Size &imSize, const InfoMaxWeights &weights);
+
+    //------------------------------------------------------------------------
+    // InfoMaxEngine virtuals
+    //------------------------------------------------------------------------
+    virtual void calculateImageDifferences(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                           std::vector<float> &differences) const override;
+    virtual std::unique_ptr<InfoMaxEngine> clone() const override;
+
+    using InfoMaxEngine::calculateImageDifferences;
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // Scratch buffers for rotated inputs and hidden unit activations, one column per rotation
+    mutable Eigen::MatrixXf m_ScratchInputs;
+    mutable Eigen::MatrixXf m_ScratchActivations;
+};
+
+//------------------------------------------------------------------------
+// InfoMaxEngineFP16
+//------------------------------------------------------------------------
+// Familiarity calculated from a half precision copy of the weights, made when the engine is created, halving the
+// memory traffic of each query. Rotated images are built as 8-bit pixels and dotted with rows of weights using F16C
+// and FMA instructions where available. Rotated images don't generally fit in cache so units and rotations are
+// worked through in tiles which fit in L2 together - the weights are streamed once per query and the rotated
+// images once per tile of units. The 1/255 pixel scale is applied to each activation
+class InfoMaxEngineFP16 : public InfoMaxEngine
+{
+public:
+    InfoMaxEngineFP16(const cv::Size &imSize, const InfoMaxWeights &weights);
+
+    //------------------------------------------------------------------------
+    // InfoMaxEngine virtuals
+    //------------------------------------------------------------------------
+    virtual void calculateImageDifferences(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                           std::vector<float> &differences) const override;
+    virtual std::unique_ptr<InfoMaxEngine> clone() const override;
+
+    using InfoMaxEngine::calculateImageDifferences;
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // Half precision weights in row-major order, shared with copies of engine
+    std::shared_ptr<const std::vector<uint16_t>> m_HalfWeights;
+
+    // Scratch buffers for rotated images, one after another, and familiarity of each
+    mutable std::vector<uint8_t> m_ScratchInputs;
+    mutable std::vector<float> m_ScratchFamiliarity;
+};
+
+//------------------------------------------------------------------------
+// InfoMaxEngineInt8
+//------------------------------------------------------------------------
+// Familiarity calculated from an 8-bit copy of the weights, made when the engine is created, with one scale per
+// hidden unit (row) so each row uses the full [-127, 127] range. Dot products with 8-bit pixels are calculated
+// exactly in integer arithmetic, using AVX2 where available, and then scaled back to floating point, so the only
+// error comes from quantising the weights. Units and rotations are worked through in tiles like InfoMaxEngineFP16
+class InfoMaxEngineInt8 : public InfoMaxEngine
+{
+public:
+    InfoMaxEngineInt8(const cv::Size &imSize, const InfoMaxWeights &weights);
+
+    //------------------------------------------------------------------------
+    // InfoMaxEngine virtuals
+    //------------------------------------------------------------------------
+    virtual void calculateImageDifferences(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                           std::vector<float> &differences) const override;
+    virtual std::unique_ptr<InfoMaxEngine> clone() const override;
+
+    using InfoMaxEngine::calculateImageDifferences;
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // Quantised weights in row-major order and scale of each row, shared with copies of engine
+    std::shared_ptr<const std::vector<int8_t>> m_QuantisedWeights;
+    std::shared_ptr<const std::vector<float>> m_RowScales;
+
+    // Scratch buffers for rotated images, one after another, and familiarity of each
+    mutable std::vector<uint8_t> m_ScratchInputs;
+    mutable std::vector<float> m_ScratchFamiliarity;
+};
+
+//------------------------------------------------------------------------
+// InfoMaxEngineFFT
+//------------------------------------------------------------------------
+// Familiarity calculated using FFTs. Because rotations only permute columns, each hidden unit's activations at
+// every rotation are the circular cross-correlation of its row of weights, reshaped to the image size, with the
+// image. The spectra of the rows of each unit's weights are calculated once when the engine is created so each
+// query needs one FFT of the image, a product of spectra summed across rows for each unit and a batch of inverse
+// FFTs - O(units.H.W + units.W log W) rather than O(units.H.W^2). All rotations are always calculated.
+// **NOTE** the weight spectra, H x (W / 2 + 1) complex floats per unit, take about as much memory as the float weights
+class InfoMaxEngineFFT : public InfoMaxEngine
+{
+public:
+    InfoMaxEngineFFT(const cv::Size &imSize, const InfoMaxWeights &weights);
+
+    //------------------------------------------------------------------------
+    // InfoMaxEngine virtuals
+    //------------------------------------------------------------------------
+    virtual void calculateImageDifferences(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                           std::vector<float> &differences) const override;
+    virtual std::unique_ptr<InfoMaxEngine> clone() const override;
+
+    using InfoMaxEngine::calculateImageDifferences;
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // Number of non-redundant frequencies in spectrum of each row
+    const int m_NumFrequencies;
+
+    // Non-redundant half of the spectrum of each row of each unit's weights, shared with copies of engine
+    std::shared_ptr<const std::vector<std::complex<float>>> m_WeightSpectra;
+
+    // Scratch buffers
+    mutable cv::Mat m_ScratchFloatImage;
+    mutable cv::Mat m_ScratchImageSpectra;
+    mutable cv::Mat m_ScratchCrossSpectra;
+    mutable cv::Mat m_ScratchActivations;
+};
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+// Create InfoMax engine by name. weights must outlive engine
+std::unique_ptr<InfoMaxEngine> createInfoMaxEngine(const std::string &name, const cv::Size &imSize, const InfoMaxWeights &weights);
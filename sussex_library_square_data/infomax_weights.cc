@@ -0,0 +1,217 @@
+#include "infomax_weights.h"
+
+// Standard C++ includes
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// POSIX includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash.h"
+
+//------------------------------------------------------------------------
+// Anonymous namespace
+//------------------------------------------------------------------------
+namespace
+{
+// Header written at start of weight files. Weights start at s_WeightFileDataOffset so they are page-aligned
+const char s_WeightFileMagic[4] = {'I', 'M', 'X', 'W'};
+const int32_t s_WeightFileVersion = 2;
+const size_t s_WeightFileDataOffset = 4096;
+
+// Element types which weights can be stored as
+enum class WeightType : int32_t
+{
+    Float32 = 0,
+};
+
+// Flags describing weights
+enum WeightFlags : int32_t
+{
+    WeightFlagUnverified = (1 << 0),
+};
+
+// Header layout - fixed-size fields in order so it can be copied directly to and from disk
+struct WeightFileHeader
+{
+    char magic[4];
+    int32_t version;
+    int32_t imageSize[2];
+    int32_t matrixSize[2];
+    WeightType type;
+    int32_t flags;
+    uint64_t trainingHash;
+    uint64_t weightHash;
+};
+static_assert(sizeof(WeightFileHeader) == 48, "Unexpected weight file header layout");
+
+// Prefix of git-LFS pointer files, which are checked in in place of large weight files
+const char s_LFSPointerPrefix[] = "version https://git-lfs";
+
+// Hash weights so corruption of weight files can be detected when they are mapped
+uint64_t hashWeights(const float *weights, size_t numWeights)
+{
+    FNV1AHash hash;
+    hash.update(weights, numWeights * sizeof(float));
+    return hash.get();
+}
+}   // Anonymous namespace
+
+//------------------------------------------------------------------------
+// InfoMaxWeights
+//------------------------------------------------------------------------
+InfoMaxWeights::InfoMaxWeights(MatrixType weights, bool verified)
+:   m_OwnedWeights(std::move(weights)), m_MappedData(nullptr), m_MappedLength(0),
+    m_Weights(m_OwnedWeights.data(), m_OwnedWeights.rows(), m_OwnedWeights.cols()), m_Verified(verified)
+{
+}
+//------------------------------------------------------------------------
+InfoMaxWeights::InfoMaxWeights(void *mappedData, size_t mappedLength, int rows, int cols, bool verified)
+:   m_MappedData(mappedData), m_MappedLength(mappedLength),
+    m_Weights(reinterpret_cast<const float *>(reinterpret_cast<const char *>(mappedData) + s_WeightFileDataOffset), rows, cols),
+    m_Verified(verified)
+{
+}
+//------------------------------------------------------------------------
+InfoMaxWeights::~InfoMaxWeights()
+{
+    if(m_MappedData != nullptr) {
+        munmap(m_MappedData, m_MappedLength);
+    }
+}
+//------------------------------------------------------------------------
+bool InfoMaxWeights::write(const filesystem::path &weightPath, const cv::Size &imSize, uint64_t trainingHash) const
+{
+    WeightFileHeader header;
+    std::copy(std::begin(s_WeightFileMagic), std::end(s_WeightFileMagic), header.magic);
+    header.version = s_WeightFileVersion;
+    header.imageSize[0] = imSize.width;
+    header.imageSize[1] = imSize.height;
+    header.matrixSize[0] = (int32_t)m_Weights.rows();
+    header.matrixSize[1] = (int32_t)m_Weights.cols();
+    header.type = WeightType::Float32;
+    header.flags = m_Verified ? 0 : WeightFlagUnverified;
+    header.trainingHash = trainingHash;
+    header.weightHash = hashWeights(m_Weights.data(), m_Weights.size());
+
+    // Write to temporary file and then rename so concurrent runs never see a partial file
+    const std::string temporaryPath = weightPath.str() + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream os(temporaryPath, std::ios::binary);
+        os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        // Pad header so weights are page-aligned
+        const std::vector<char> padding(s_WeightFileDataOffset - sizeof(header), 0);
+        os.write(padding.data(), padding.size());
+        os.write(reinterpret_cast<const char *>(m_Weights.data()), m_Weights.size() * sizeof(float));
+        if(!os.good()) {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+    if(std::rename(temporaryPath.c_str(), weightPath.str().c_str()) != 0) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    else {
+        return true;
+    }
+}
+//------------------------------------------------------------------------
+std::unique_ptr<InfoMaxWeights> InfoMaxWeights::map(const filesystem::path &weightPath, const cv::Size &imSize, uint64_t trainingHash)
+{
+    const int fd = open(weightPath.str().c_str(), O_RDONLY);
+    if(fd < 0) {
+        return nullptr;
+    }
+
+    // Read header
+    WeightFileHeader header;
+    struct stat status;
+    if(fstat(fd, &status) != 0 || pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+        close(fd);
+        std::cerr << "Weight file " << weightPath << " is too short - ignoring" << std::endl;
+        return nullptr;
+    }
+
+    // Check header and size of file match
+    const size_t length = s_WeightFileDataOffset + ((size_t)header.matrixSize[0] * (size_t)header.matrixSize[1] * sizeof(float));
+    if(!std::equal(std::begin(s_WeightFileMagic), std::end(s_WeightFileMagic), header.magic)
+        || header.version != s_WeightFileVersion || header.type != WeightType::Float32
+        || header.matrixSize[0] <= 0 || header.matrixSize[1] <= 0 || (size_t)status.st_size != length)
+    {
+        close(fd);
+        std::cerr << "Weight file " << weightPath << " is not a valid version " << s_WeightFileVersion << " weight file - ignoring" << std::endl;
+        return nullptr;
+    }
+    if(header.imageSize[0] != imSize.width || header.imageSize[1] != imSize.height
+        || header.matrixSize[0] != imSize.area() || header.matrixSize[1] != imSize.area() || header.trainingHash != trainingHash)
+    {
+        close(fd);
+        std::cerr << "Weight file " << weightPath << " was trained on different images - ignoring" << std::endl;
+        return nullptr;
+    }
+
+    // Map file
+    void *data = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return nullptr;
+    }
+
+    // Check weights match the hash they were written with
+    const float *weights = reinterpret_cast<const float *>(reinterpret_cast<const char *>(data) + s_WeightFileDataOffset);
+    if(hashWeights(weights, (size_t)header.matrixSize[0] * (size_t)header.matrixSize[1]) != header.weightHash) {
+        munmap(data, length);
+        std::cerr << "Weight file " << weightPath << " is corrupt - ignoring" << std::endl;
+        return nullptr;
+    }
+    return std::unique_ptr<InfoMaxWeights>(new InfoMaxWeights(data, length, header.matrixSize[0], header.matrixSize[1],
+                                                              (header.flags & WeightFlagUnverified) == 0));
+}
+//------------------------------------------------------------------------
+std::unique_ptr<InfoMaxWeights> InfoMaxWeights::readLegacy(const filesystem::path &weightPath, const cv::Size &imSize)
+{
+    std::ifstream is(weightPath.str(), std::ios::binary | std::ios::ate);
+    if(!is.good()) {
+        return nullptr;
+    }
+    const size_t fileSize = (size_t)is.tellg();
+    is.seekg(0);
+
+    // Check for git-LFS pointers
+    char prefix[sizeof(s_LFSPointerPrefix) - 1];
+    if(is.read(prefix, sizeof(prefix)) && std::equal(std::begin(prefix), std::end(prefix), s_LFSPointerPrefix)) {
+        std::cerr << "Weight file " << weightPath << " is a git-LFS pointer - ignoring" << std::endl;
+        return nullptr;
+    }
+    is.clear();
+    is.seekg(0);
+
+    // The matrix size is encoded as 2 x int32_t - check it matches image size, with as many hidden units as inputs, and file size
+    int32_t size[2];
+    is.read(reinterpret_cast<char *>(size), sizeof(size));
+    if(!is.good() || size[0] != imSize.area() || size[1] != imSize.area()
+        || fileSize != (sizeof(size) + ((size_t)size[0] * (size_t)size[1] * sizeof(float))))
+    {
+        std::cerr << "Weight file " << weightPath << " does not match image size - ignoring" << std::endl;
+        return nullptr;
+    }
+
+    MatrixType weights(size[0], size[1]);
+    is.read(reinterpret_cast<char *>(weights.data()), sizeof(float) * weights.size());
+    if(!is.good()) {
+        return nullptr;
+    }
+    // There is no record of what legacy weights were trained on
+    return std::unique_ptr<InfoMaxWeights>(new InfoMaxWeights(std::move(weights), false));
+}
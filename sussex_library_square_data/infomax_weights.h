@@ -0,0 +1,75 @@
+#pragma once
+
+// Standard C++ includes
+#include <cstdint>
+#include <memory>
+
+// Eigen
+#include <Eigen/Core>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// BoB robotics 3rd party includes
+#include "third_party/path.h"
+
+//------------------------------------------------------------------------
+// InfoMaxWeights
+//------------------------------------------------------------------------
+// InfoMax weight matrix, either owned or memory-mapped from a weight file. Weight files start with a header
+// containing a magic number, format version, image size, matrix size, element type, flags, a hash of whatever
+// the weights were trained on and a hash of the weights themselves, followed by the column-major matrix at a
+// page-aligned offset. Mapped weights are shared between every process using the same file and are never copied
+// unless a consumer needs its own matrix. Weights imported from legacy weight files can't be checked against
+// what they were trained on so are flagged as unverified, in memory and in any weight file they are written to
+class InfoMaxWeights
+{
+public:
+    using MatrixType = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic>;
+    using MapType = Eigen::Map<const MatrixType>;
+
+    InfoMaxWeights(MatrixType weights, bool verified = true);
+    ~InfoMaxWeights();
+
+    InfoMaxWeights(const InfoMaxWeights &) = delete;
+    InfoMaxWeights &operator=(const InfoMaxWeights &) = delete;
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    const MapType &getWeights() const{ return m_Weights; }
+
+    // Are weights known to have been trained on what their training hash describes?
+    bool isVerified() const{ return m_Verified; }
+
+    // Write weights to weightPath, returning false if this fails
+    bool write(const filesystem::path &weightPath, const cv::Size &imSize, uint64_t trainingHash) const;
+
+    //------------------------------------------------------------------------
+    // Static API
+    //------------------------------------------------------------------------
+    // Map weights from weightPath, returning nullptr if the file doesn't exist, doesn't match imSize and trainingHash or is corrupt
+    static std::unique_ptr<InfoMaxWeights> map(const filesystem::path &weightPath, const cv::Size &imSize, uint64_t trainingHash);
+
+    // Read weights from a legacy weight file (two int32 matrix dimensions followed by floats), returning
+    // nullptr if the file doesn't exist or its size doesn't match - e.g. if it's a git-LFS pointer. Weights are unverified
+    static std::unique_ptr<InfoMaxWeights> readLegacy(const filesystem::path &weightPath, const cv::Size &imSize);
+
+private:
+    InfoMaxWeights(void *mappedData, size_t mappedLength, int rows, int cols, bool verified);
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // Owned weights - empty if weights are mapped
+    MatrixType m_OwnedWeights;
+
+    // Memory-mapped weight file
+    void *m_MappedData;
+    size_t m_MappedLength;
+
+    // View of either owned or mapped weights
+    MapType m_Weights;
+
+    const bool m_Verified;
+};
@@ -1,11 +1,81 @@
 #include "memory.h"
 
+// Standard C++ includes
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iterator>
+#include <random>
+#include <sstream>
+
+// BoB robotics includes
+#include "common/assert.h"
+
+#include "hash.h"
+#include "snapshot_cache.h"
+#include "worker_pool.h"
+
 using namespace BoBRobotics;
 using namespace units::literals;
 using namespace units::length;
 using namespace units::angle;
 using namespace units::math;
 
+//------------------------------------------------------------------------
+// Anonymous namespace
+//------------------------------------------------------------------------
+namespace
+{
+// Convert column into heading
+degree_t getColumnHeading(int column, int width, degree_t snapshotHeading)
+{
+    // Convert column into pixel rotation
+    int pixelRotation = column;
+    if(pixelRotation > (width / 2)) {
+        pixelRotation -= width;
+    }
+
+    // Convert this into angle
+    return snapshotHeading + turn_t((double)pixelRotation / (double)width);
+}
+//------------------------------------------------------------------------
+// Get ranges of columns, sorted by column, whose headings are within FOV of the route heading. Columns c are within
+// FOV if the shortest distance around the image between c and the column pointing along the route is less than FOV
+// in columns. These form a single interval of columns which is split into two ranges if it wraps around the image
+std::vector<ColumnRange> getFOVColumnRanges(int width, degree_t snapshotHeading, degree_t nearestRouteHeading, degree_t fov)
+{
+    // Get (fractional) column pointing along route and FOV in columns. Multiplying before dividing keeps these exact
+    // for whole degrees so columns exactly FOV away from the route are consistently excluded
+    const double centreColumn = (nearestRouteHeading - snapshotHeading).value() * (double)width / 360.0;
+    const double fovColumns = fov.value() * (double)width / 360.0;
+
+    // Get unwrapped range of columns strictly within FOV of centre column
+    int begin = (int)std::floor(centreColumn - fovColumns) + 1;
+    int end = (int)std::ceil(centreColumn + fovColumns);
+
+    // If FOV covers all columns, return one range or, if it doesn't cover any, none
+    if((end - begin) >= width) {
+        return {ColumnRange(0, width)};
+    }
+    else if(end <= begin) {
+        return {};
+    }
+
+    // Wrap start of range into [0, width)
+    const int wrappedBegin = ((begin % width) + width) % width;
+    end += wrappedBegin - begin;
+    begin = wrappedBegin;
+
+    // Split range if it wraps around
+    if(end <= width) {
+        return {ColumnRange(begin, end)};
+    }
+    else {
+        return {ColumnRange(0, end - width), ColumnRange(begin, width)};
+    }
+}
+}   // Anonymous namespace
+
 //------------------------------------------------------------------------
 // MemoryBase
 //------------------------------------------------------------------------
@@ -29,47 +99,65 @@ void MemoryBase::writeCSVLine(std::ostream &os, centimeter_t snapshotX, centimet
 // PerfectMemory
 //------------------------------------------------------------------------
 PerfectMemory::PerfectMemory(const cv::Size &imSize, const Navigation::ImageDatabase &route,
-                             bool renderGoodMatches, bool renderBadMatches)
-:   MemoryBase(imSize), m_PM(imSize), m_Route(route), m_BestSnapshotIndex(std::numeric_limits<size_t>::max()),
-    m_RenderGoodMatches(renderGoodMatches), m_RenderBadMatches(renderBadMatches)
+                             bool renderGoodMatches, bool renderBadMatches, const std::string &ridfEngine,
+                             size_t prefilterCandidates)
+:   PerfectMemory(imSize, route, SnapshotCache(route, imSize), renderGoodMatches, renderBadMatches, ridfEngine, prefilterCandidates)
 {
-    m_PM.trainRoute(route, true);
+}
+//------------------------------------------------------------------------
+PerfectMemory::PerfectMemory(const cv::Size &imSize, const Navigation::ImageDatabase &route, const SnapshotCache &snapshots,
+                             bool renderGoodMatches, bool renderBadMatches, const std::string &ridfEngine,
+                             size_t prefilterCandidates)
+:   MemoryBase(imSize), m_RIDFEngine(createRIDFEngine(ridfEngine, imSize, prefilterCandidates)), m_Route(route),
+    m_BestSnapshotIndex(std::numeric_limits<size_t>::max()), m_RenderGoodMatches(renderGoodMatches), m_RenderBadMatches(renderBadMatches)
+{
+    // Train each resized snapshot
+    for(size_t i = 0; i < snapshots.size(); i++) {
+        m_RIDFEngine->train(snapshots[i]);
+    }
     std::cout << "Trained on " << route.size() << " snapshots" << std::endl;
 }
 //------------------------------------------------------------------------
+PerfectMemory::PerfectMemory(const PerfectMemory &other)
+:   MemoryBase(other), m_RIDFEngine(other.m_RIDFEngine->clone()), m_Route(other.m_Route),
+    m_BestSnapshotIndex(other.m_BestSnapshotIndex), m_RenderGoodMatches(other.m_RenderGoodMatches),
+    m_RenderBadMatches(other.m_RenderBadMatches)
+{
+}
+//------------------------------------------------------------------------
 void PerfectMemory::test(const cv::Mat &snapshot, degree_t snapshotHeading, degree_t)
 {
-    // Get heading directly from Perfect Memory
-    degree_t bestHeading;
+    // Find best snapshot and rotation - as in PerfectMemoryRotater, ties are won by the lowest snapshot index and then the lowest rotation
+    size_t bestSnapshot;
+    int bestColumn;
     float lowestDifference;
-    std::tie(bestHeading, m_BestSnapshotIndex, lowestDifference, std::ignore) = getPM().getHeading(snapshot);
+    std::tie(bestSnapshot, bestColumn, lowestDifference) = getRIDFEngine().findBestMatch(snapshot, {ColumnRange(0, getImageSize().width)});
+    setBestSnapshotIndex(bestSnapshot);
 
-    // Set best heading and vector length
-    setBestHeading(snapshotHeading + bestHeading);
-    setLowestDifference(lowestDifference);
+    // Set best heading
+    setBestHeading(getColumnHeading(bestColumn, getImageSize().width, snapshotHeading));
+
+    // Scale difference to match code in ridf_processors.h:57
+    setLowestDifference(lowestDifference / 255.0f);
 
     // Calculate vector length
-    setVectorLength(1.0f - lowestDifference);
+    setVectorLength(1.0f - getLowestDifference());
 }
 //------------------------------------------------------------------------
 std::vector<float> PerfectMemory::calculateRIDF(const cv::Mat &snapshot) const
 {
-    // Get 'matrix' of differences from perfect memory
-    const auto &allDifferences = getPM().getImageDifferences(snapshot);
-
-    // Reserve vector to hold RIDF
-    std::vector<float> ridf(getImageSize().width, std::numeric_limits<float>::max());
-
-    // Loop through all snapshots
-    for(const auto &memDifferences : allDifferences) {
-        for(int c = 0; c < getImageSize().width; c++) {
-            ridf[c] = std::min(ridf[c], memDifferences[c]);
-        }
-    }
-
+    // Get lowest difference at each rotation
+    std::vector<float> ridf;
+    std::vector<size_t> bestSnapshots;
+    getRIDFEngine().calculateColumnMinima(snapshot, ridf, bestSnapshots);
     return ridf;
 }
 //------------------------------------------------------------------------
+std::unique_ptr<MemoryBase> PerfectMemory::clone() const
+{
+    return std::unique_ptr<MemoryBase>(new PerfectMemory(*this));
+}
+//------------------------------------------------------------------------
 void PerfectMemory::writeCSVHeader(std::ostream &os)
 {
     // Superclass
@@ -110,50 +198,167 @@ void PerfectMemory::render(cv::Mat &image, centimeter_t snapshotX, centimeter_t
 // PerfectMemoryConstrained
 //------------------------------------------------------------------------
 PerfectMemoryConstrained::PerfectMemoryConstrained(const cv::Size &imSize, const Navigation::ImageDatabase &route, degree_t fov,
-                                                   bool renderGoodMatches, bool renderBadMatches)
-:   PerfectMemory(imSize, route, renderGoodMatches, renderBadMatches), m_FOV(fov)
+                                                   bool renderGoodMatches, bool renderBadMatches, const std::string &ridfEngine,
+                                                   size_t prefilterCandidates)
+:   PerfectMemory(imSize, route, renderGoodMatches, renderBadMatches, ridfEngine, prefilterCandidates), m_FOV(fov)
 {
 }
 //------------------------------------------------------------------------
 void PerfectMemoryConstrained::test(const cv::Mat &snapshot, degree_t snapshotHeading, degree_t nearestRouteHeading)
 {
-    // Get 'matrix' of differences from perfect memory
-    const auto &allDifferences = getPM().getImageDifferences(snapshot);
+    // Get ranges of columns within FOV
+    const auto columnRanges = getFOVColumnRanges(getImageSize().width, snapshotHeading, nearestRouteHeading, m_FOV);
+
+    // Find best snapshot and rotation within these
+    size_t bestSnapshot;
+    int bestColumn;
+    float lowestDifference;
+    std::tie(bestSnapshot, bestColumn, lowestDifference) = getRIDFEngine().findBestMatch(snapshot, columnRanges);
 
-    // Loop through snapshots
-    // **NOTE** this currently uses a super-naive approach as more efficient solution is non-trivial because
-    // columns that represent the rotations are not necessarily contiguous - there is a dis-continuity in the middle
+    // Check valid snapshot actually exists
+    BOB_ASSERT(bestSnapshot != std::numeric_limits<size_t>::max());
+
+    setBestSnapshotIndex(bestSnapshot);
+    setBestHeading(getColumnHeading(bestColumn, getImageSize().width, snapshotHeading));
+
+    // Scale difference to match code in ridf_processors.h:57
+    setLowestDifference(lowestDifference / 255.0f);
+
+    // Calculate vector length
+    setVectorLength(1.0f - getLowestDifference());
+}
+//------------------------------------------------------------------------
+std::unique_ptr<MemoryBase> PerfectMemoryConstrained::clone() const
+{
+    return std::unique_ptr<MemoryBase>(new PerfectMemoryConstrained(*this));
+}
+
+//------------------------------------------------------------------------
+// PerfectMemoryANN
+//------------------------------------------------------------------------
+PerfectMemoryANN::PerfectMemoryANN(const cv::Size &imSize, const Navigation::ImageDatabase &route,
+                                   bool renderGoodMatches, bool renderBadMatches, const std::string &ridfEngine,
+                                   size_t numCandidates, size_t efSearch)
+:   PerfectMemoryANN(imSize, route, SnapshotCache(route, imSize), renderGoodMatches, renderBadMatches, ridfEngine,
+                     numCandidates, efSearch)
+{
+}
+//------------------------------------------------------------------------
+PerfectMemoryANN::PerfectMemoryANN(const cv::Size &imSize, const Navigation::ImageDatabase &route, const SnapshotCache &snapshots,
+                                   bool renderGoodMatches, bool renderBadMatches, const std::string &ridfEngine,
+                                   size_t numCandidates, size_t efSearch)
+:   PerfectMemory(imSize, route, snapshots, renderGoodMatches, renderBadMatches, ridfEngine, 0), m_NumCandidates(numCandidates),
+    m_EFSearch(efSearch), m_ScratchSortedImage(imSize.area())
+{
+    BOB_ASSERT(numCandidates > 0);
+
+    // Index sorted rows of each resized snapshot
+    auto index = std::make_shared<HNSWIndex>(imSize.area());
+    for(size_t i = 0; i < snapshots.size(); i++) {
+        sortRows(snapshots[i].ptr<uint8_t>(), imSize, m_ScratchSortedImage.data());
+        index->add(m_ScratchSortedImage.data());
+    }
+    m_Index = index;
+    std::cout << "Indexed " << m_Index->size() << " snapshots" << std::endl;
+}
+//------------------------------------------------------------------------
+void PerfectMemoryANN::test(const cv::Mat &snapshot, degree_t snapshotHeading, degree_t)
+{
+    // Shortlist snapshots with the most similar sorted rows
+    sortRows(snapshot.ptr<uint8_t>(), getImageSize(), m_ScratchSortedImage.data());
+    const auto neighbours = m_Index->search(m_ScratchSortedImage.data(), m_NumCandidates, m_EFSearch, m_ScratchVisitMarks);
+    m_ScratchCandidates.clear();
+    std::transform(neighbours.cbegin(), neighbours.cend(), std::back_inserter(m_ScratchCandidates),
+                   [](const HNSWIndex::Neighbour &n){ return n.second; });
+
+    // Find best snapshot and rotation amongst shortlist
+    size_t bestSnapshot;
+    int bestColumn;
+    float lowestDifference;
+    std::tie(bestSnapshot, bestColumn, lowestDifference) = getRIDFEngine().findBestMatch(snapshot, {ColumnRange(0, getImageSize().width)},
+                                                                                         m_ScratchCandidates);
+    setBestSnapshotIndex(bestSnapshot);
+
+    // Set best heading
+    setBestHeading(getColumnHeading(bestColumn, getImageSize().width, snapshotHeading));
+
+    // Scale difference to match code in ridf_processors.h:57
+    setLowestDifference(lowestDifference / 255.0f);
+
+    // Calculate vector length
+    setVectorLength(1.0f - getLowestDifference());
+}
+//------------------------------------------------------------------------
+std::unique_ptr<MemoryBase> PerfectMemoryANN::clone() const
+{
+    return std::unique_ptr<MemoryBase>(new PerfectMemoryANN(*this));
+}
+
+//------------------------------------------------------------------------
+// PerfectMemorySequence
+//------------------------------------------------------------------------
+PerfectMemorySequence::PerfectMemorySequence(const cv::Size &imSize, const Navigation::ImageDatabase &route,
+                                             bool renderGoodMatches, bool renderBadMatches, const std::string &ridfEngine,
+                                             size_t windowSize, float differenceThreshold)
+:   PerfectMemory(imSize, route, renderGoodMatches, renderBadMatches, ridfEngine), m_WindowSize(windowSize),
+    m_DifferenceThreshold(differenceThreshold)
+{
+    BOB_ASSERT(windowSize > 0);
+}
+//------------------------------------------------------------------------
+void PerfectMemorySequence::test(const cv::Mat &snapshot, degree_t snapshotHeading, degree_t)
+{
+    const size_t numSnapshots = getRIDFEngine().getNumSnapshots();
+
+    // If there is no previous best match, start with window covering whole route
+    const size_t previousBestSnapshot = getBestSnapshotIndex();
+    size_t windowSize = (previousBestSnapshot == std::numeric_limits<size_t>::max()) ? numSnapshots : m_WindowSize;
+
+    // Snapshots already compared, as window only grows these are always a contiguous range
+    size_t searchedBegin = 0;
+    size_t searchedEnd = 0;
+
+    size_t bestSnapshot = std::numeric_limits<size_t>::max();
+    int bestColumn = -1;
     float lowestDifference = std::numeric_limits<float>::max();
-    setBestSnapshotIndex(std::numeric_limits<size_t>::max());
-    setBestHeading(0_deg);
-    for(size_t i = 0; i < allDifferences.size(); i++) {
-        const auto &snapshotDifferences = allDifferences[i];
-
-        // Loop through acceptable ram_ImageWidthnge of columns
-        for(int c = 0; c < getImageSize().width; c++) {
-            // If this snapshot is a better match than current best
-            if(snapshotDifferences[c] < lowestDifference) {
-                // Convert column into pixel rotation
-                int pixelRotation = c;
-                if(pixelRotation > (getImageSize().width / 2)) {
-                    pixelRotation -= getImageSize().width;
-                }
-
-                // Convert this into angle
-                const degree_t heading = snapshotHeading + turn_t((double)pixelRotation / (double)getImageSize().width);
-
-                // If the distance between this angle from grid and route angle is within FOV, update best
-                if(fabs(shortestAngleBetween(heading, nearestRouteHeading)) < m_FOV) {
-                    setBestSnapshotIndex(i);
-                    setBestHeading(heading);
-                    lowestDifference = snapshotDifferences[c];
-                }
+    while(true) {
+        // Get snapshots within window of previous best match which haven't already been compared
+        const size_t begin = (windowSize >= numSnapshots) ? 0 : ((previousBestSnapshot > windowSize) ? (previousBestSnapshot - windowSize) : 0);
+        const size_t end = (windowSize >= numSnapshots) ? numSnapshots : std::min(numSnapshots, previousBestSnapshot + windowSize + 1);
+        m_ScratchCandidates.clear();
+        for(size_t s = begin; s < end; s++) {
+            if(s < searchedBegin || s >= searchedEnd) {
+                m_ScratchCandidates.push_back(s);
             }
         }
+        searchedBegin = begin;
+        searchedEnd = end;
+
+        // Find best snapshot and rotation amongst these and, if it's better than best so far (breaking ties
+        // in the same way as findBestMatch), update best so result matches searching whole window at once
+        size_t windowBestSnapshot;
+        int windowBestColumn;
+        float windowLowestDifference;
+        std::tie(windowBestSnapshot, windowBestColumn, windowLowestDifference) = getRIDFEngine().findBestMatch(snapshot, {ColumnRange(0, getImageSize().width)},
+                                                                                                               m_ScratchCandidates);
+        if(windowLowestDifference < lowestDifference
+            || (windowLowestDifference == lowestDifference && std::tie(windowBestSnapshot, windowBestColumn) < std::tie(bestSnapshot, bestColumn)))
+        {
+            bestSnapshot = windowBestSnapshot;
+            bestColumn = windowBestColumn;
+            lowestDifference = windowLowestDifference;
+        }
+
+        // Stop if match is good enough or window already covers whole route, otherwise widen window
+        if((lowestDifference / 255.0f) <= m_DifferenceThreshold || (begin == 0 && end == numSnapshots)) {
+            break;
+        }
+        windowSize *= 2;
     }
+    setBestSnapshotIndex(bestSnapshot);
 
-    // Check valid snapshot actually exists
-    assert(getBestSnapshotIndex() != std::numeric_limits<size_t>::max());
+    // Set best heading
+    setBestHeading(getColumnHeading(bestColumn, getImageSize().width, snapshotHeading));
 
     // Scale difference to match code in ridf_processors.h:57
     setLowestDifference(lowestDifference / 255.0f);
@@ -161,25 +366,40 @@ void PerfectMemoryConstrained::test(const cv::Mat &snapshot, degree_t snapshotHe
     // Calculate vector length
     setVectorLength(1.0f - getLowestDifference());
 }
+//------------------------------------------------------------------------
+std::unique_ptr<MemoryBase> PerfectMemorySequence::clone() const
+{
+    return std::unique_ptr<MemoryBase>(new PerfectMemorySequence(*this));
+}
 
 //------------------------------------------------------------------------
 // InfoMax
 //------------------------------------------------------------------------
-InfoMax::InfoMax(const cv::Size &imSize, const Navigation::ImageDatabase &route)
-    : MemoryBase(imSize), m_InfoMax(createInfoMax(imSize, route))
+InfoMax::InfoMax(const cv::Size &imSize, const Navigation::ImageDatabase &route, const InfoMaxTrainingParameters &trainingParameters,
+                 const std::string &infoMaxEngine)
+    : MemoryBase(imSize), m_Weights(createWeights(imSize, route, trainingParameters)),
+    m_InfoMaxEngine(createInfoMaxEngine(infoMaxEngine, imSize, *m_Weights))
+{
+}
+//------------------------------------------------------------------------
+InfoMax::InfoMax(const InfoMax &other)
+:   MemoryBase(other), m_Weights(other.m_Weights), m_InfoMaxEngine(other.m_InfoMaxEngine->clone())
 {
 }
 //------------------------------------------------------------------------
 void InfoMax::test(const cv::Mat &snapshot, degree_t snapshotHeading, degree_t)
 {
-    // Get heading directly from InfoMax
-    degree_t bestHeading;
-    float lowestDifference;
-    std::tie(bestHeading, lowestDifference, std::ignore) = m_InfoMax.getHeading(snapshot);
+    // Get familiarity at every rotation
+    std::vector<float> differences;
+    getInfoMaxEngine().calculateImageDifferences(snapshot, differences);
+
+    // Find most familiar rotation - as in InfoMaxRotater, ties are won by the lowest rotation
+    const auto bestDifference = std::min_element(differences.cbegin(), differences.cend());
+    const int bestColumn = (int)std::distance(differences.cbegin(), bestDifference);
 
     // Set best heading and vector length
-    setBestHeading(snapshotHeading + bestHeading);
-    setLowestDifference(lowestDifference);
+    setBestHeading(getColumnHeading(bestColumn, getImageSize().width, snapshotHeading));
+    setLowestDifference(*bestDifference);
 
     // **TODO** calculate vector length
     setVectorLength(1.0f);
@@ -187,91 +407,186 @@ void InfoMax::test(const cv::Mat &snapshot, degree_t snapshotHeading, degree_t)
 //------------------------------------------------------------------------
 std::vector<float> InfoMax::calculateRIDF(const cv::Mat &snapshot) const
 {
-    return getInfoMax().getImageDifferences(snapshot);
+    std::vector<float> differences;
+    getInfoMaxEngine().calculateImageDifferences(snapshot, differences);
+    return differences;
 }
 //------------------------------------------------------------------------
-void InfoMax::writeWeights(const InfoMax::InfoMaxWeightMatrixType &weights, const filesystem::path &weightPath)
+std::unique_ptr<MemoryBase> InfoMax::clone() const
 {
-    // Write weights to disk
-    std::ofstream netFile(weightPath.str(), std::ios::binary);
-    const int size[2] { (int) weights.rows(), (int) weights.cols() };
-    netFile.write(reinterpret_cast<const char *>(size), sizeof(size));
-    netFile.write(reinterpret_cast<const char *>(weights.data()), weights.size() * sizeof(float));
+    return std::unique_ptr<MemoryBase>(new InfoMax(*this));
 }
 //------------------------------------------------------------------------
-// **TODO** move into BoB robotics
-InfoMax::InfoMaxWeightMatrixType InfoMax::readWeights(const filesystem::path &weightPath)
+InfoMaxWeights::MatrixType InfoMax::trainWeights(const cv::Size &imSize, const Navigation::ImageDatabase &route,
+                                                 const InfoMaxTrainingParameters &trainingParameters)
 {
-    // Open file
-    std::ifstream is(weightPath.str(), std::ios::binary);
-    if (!is.good()) {
-        throw std::runtime_error("Could not open " + weightPath.str());
+    using MatrixType = InfoMaxWeights::MatrixType;
+
+    BOB_ASSERT(trainingParameters.batchSize > 0);
+    BOB_ASSERT(trainingParameters.numEpochs > 0);
+
+    // Training runs on this thread alone so let Eigen parallelise its matrix products
+    const ScopedEigenThreads eigenThreads((int)trainingParameters.numThreads);
+
+    // Convert snapshots into matrix with one column per snapshot, scaled to [0, 1] in the same way as InfoMaxRotater
+    const SnapshotCache snapshots(route, imSize, trainingParameters.numThreads);
+    const int numInputs = imSize.area();
+    const int numSnapshots = (int)snapshots.size();
+    MatrixType inputs(numInputs, numSnapshots);
+    for(int i = 0; i < numSnapshots; i++) {
+        inputs.col(i) = Eigen::Map<const Eigen::Matrix<uint8_t, Eigen::Dynamic, 1>>(snapshots[i].ptr<uint8_t>(), numInputs).cast<float>() / 255.0f;
     }
 
-    // The matrix size is encoded as 2 x int32_t
-    int32_t size[2];
-    is.read(reinterpret_cast<char *>(&size), sizeof(size));
+    // InfoMaxRotater has as many hidden units as inputs and scales learning rate by number of hidden units
+    MatrixType weights = generateInitialWeights(numInputs, numInputs, trainingParameters.seed);
+    const float learningRate = trainingParameters.learningRate / (float)weights.rows();
+
+    std::cout << "Training on " << numSnapshots << " snapshots in batches of " << trainingParameters.batchSize << " for "
+        << trainingParameters.numEpochs << " epochs using " << trainingParameters.numThreads << " threads" << std::endl;
+    std::cout << "Epoch, Time [s], Snapshots per second, Relative weight change, Mean familiarity" << std::endl;
+    MatrixType epochStartWeights;
+    for(size_t e = 0; e < trainingParameters.numEpochs; e++) {
+        const auto epochStart = std::chrono::steady_clock::now();
+        epochStartWeights = weights;
+
+        for(int b = 0; b < numSnapshots; b += (int)trainingParameters.batchSize) {
+            const int batchSize = std::min((int)trainingParameters.batchSize, numSnapshots - b);
+
+            // Calculate hidden unit activations for whole batch
+            const MatrixType u = weights * inputs.middleCols(b, batchSize);
+            const MatrixType yPlusU = u.array().tanh() + u.array();
+
+            // Sum of per-snapshot updates, lr / N * (I - (y + u) * u') * W, is lr / N * (B * I - (Y + U) * U') * W
+            MatrixType gradient = -yPlusU * u.transpose();
+            gradient.diagonal().array() += (float)batchSize;
+            weights.noalias() += learningRate * (gradient * weights);
+        }
+
+        const std::chrono::duration<double> epochTime = std::chrono::steady_clock::now() - epochStart;
 
-    // Create data array and fill it
-    InfoMaxWeightMatrixType data(size[0], size[1]);
-    is.read(reinterpret_cast<char *>(data.data()), sizeof(float) * data.size());
+        // Report how much weights changed and how familiar route now is (sum of absolute activations - lower is more familiar)
+        const float relativeChange = (weights - epochStartWeights).norm() / epochStartWeights.norm();
+        const float meanFamiliarity = (weights * inputs).cwiseAbs().colwise().sum().mean();
+        std::cout << e << ", " << epochTime.count() << ", " << numSnapshots / epochTime.count() << ", "
+            << relativeChange << ", " << meanFamiliarity << std::endl;
+    }
 
-    return std::move(data);
+    return weights;
 }
 //------------------------------------------------------------------------
-InfoMax::InfoMaxType InfoMax::createInfoMax(const cv::Size &imSize, const Navigation::ImageDatabase &route)
+InfoMaxWeights::MatrixType InfoMax::generateInitialWeights(int numInputs, int numHidden, unsigned int seed)
 {
-    // Create path to weights from directory containing route
-    const filesystem::path weightPath = filesystem::path(route.getPath()) / "infomax.bin";
-    if(weightPath.exists()) {
-        std::cout << "Loading weights from " << weightPath << std::endl;
-        InfoMaxType infomax(imSize, readWeights(weightPath));
-        return std::move(infomax);
+    // Draw weights from normal distribution
+    InfoMaxWeights::MatrixType weights(numInputs, numHidden);
+    std::default_random_engine generator(seed);
+    std::normal_distribution<float> distribution;
+    for(int i = 0; i < numInputs; i++) {
+        for(int j = 0; j < numHidden; j++) {
+            weights(i, j) = distribution(generator);
+        }
+    }
+
+    // Normalise each row so mean == 0 and SD == 1 and transpose
+    const Eigen::VectorXf means = weights.rowwise().mean();
+    weights.colwise() -= means;
+    const Eigen::VectorXf sd = (weights.array().square().rowwise().sum() / (float)(numHidden - 1)).sqrt();
+    weights = weights.array().colwise() / sd.array();
+    return weights.transpose();
+}
+//------------------------------------------------------------------------
+std::unique_ptr<InfoMaxWeights> InfoMax::createWeights(const cv::Size &imSize, const Navigation::ImageDatabase &route,
+                                                       const InfoMaxTrainingParameters &trainingParameters)
+{
+    // Hash everything which affects training - the route's canonical path includes its variant
+    FNV1AHash trainingHash;
+    trainingHash.update(imSize.width);
+    trainingHash.update(imSize.height);
+    trainingHash.update(filesystem::path(route.getPath()).make_absolute().str());
+    trainingHash.update(hashDatabaseImages(route));
+    trainingHash.update(trainingParameters.learningRate);
+    trainingHash.update(trainingParameters.batchSize);
+    if(trainingParameters.batchSize > 0) {
+        trainingHash.update(trainingParameters.numEpochs);
+        trainingHash.update(trainingParameters.seed);
+    }
+
+    // If weight file keyed by this hash exists alongside route and matches, map it
+    std::ostringstream weightFilename;
+    weightFilename << "infomax_weights_" << imSize.width << "x" << imSize.height << "_" << std::hex << std::setw(16)
+        << std::setfill('0') << trainingHash.get() << ".bin";
+    const filesystem::path weightPath = filesystem::path(route.getPath()) / weightFilename.str();
+    auto weights = InfoMaxWeights::map(weightPath, imSize, trainingHash.get());
+    if(weights) {
+        std::cout << "Mapped weights from " << weightPath << std::endl;
+        if(!weights->isVerified()) {
+            std::cerr << "Weights in " << weightPath << " were imported from a legacy weight file so may not have been trained on this route" << std::endl;
+        }
+        return weights;
     }
+
+    // Otherwise, if there are valid weights in the legacy format trained sequentially with the default learning rate, use those
+    const filesystem::path legacyWeightPath = filesystem::path(route.getPath()) / "infomax.bin";
+    if(trainingParameters.batchSize == 0 && trainingParameters.learningRate == InfoMaxTrainingParameters::defaultLearningRate) {
+        weights = InfoMaxWeights::readLegacy(legacyWeightPath, imSize);
+    }
+    if(weights) {
+        std::cerr << "Loaded legacy weights from " << legacyWeightPath << " - these can't be verified so may not have been trained on this route" << std::endl;
+    }
+    // Otherwise, train in minibatches
+    else if(trainingParameters.batchSize > 0) {
+        weights.reset(new InfoMaxWeights(trainWeights(imSize, route, trainingParameters)));
+    }
+    // Otherwise, train sequentially
     else {
-        InfoMaxType infomax(imSize);
+        InfoMaxType infomax(imSize, trainingParameters.learningRate);
         infomax.trainRoute(route, true);
-        writeWeights(infomax.getWeights(), weightPath.str());
         std::cout << "Trained on " << route.size() << " snapshots" << std::endl;
-        return std::move(infomax);
+        weights.reset(new InfoMaxWeights(infomax.getWeights()));
+    }
+
+    // Write weights in new format and map them back so they can be shared with other processes
+    if(weights->write(weightPath, imSize, trainingHash.get())) {
+        std::cout << "Wrote weights to " << weightPath << std::endl;
+        auto mappedWeights = InfoMaxWeights::map(weightPath, imSize, trainingHash.get());
+        if(mappedWeights) {
+            return mappedWeights;
+        }
+    }
+    else {
+        std::cerr << "Could not write weights to " << weightPath << std::endl;
     }
+    return weights;
 }
 
 
 //------------------------------------------------------------------------
 // InfoMaxConstrained
 //------------------------------------------------------------------------
-InfoMaxConstrained::InfoMaxConstrained(const cv::Size &imSize, const Navigation::ImageDatabase &route, degree_t fov)
-:   InfoMax(imSize, route), m_FOV(fov)
+InfoMaxConstrained::InfoMaxConstrained(const cv::Size &imSize, const Navigation::ImageDatabase &route, degree_t fov,
+                                       const InfoMaxTrainingParameters &trainingParameters, const std::string &infoMaxEngine)
+:   InfoMax(imSize, route, trainingParameters, infoMaxEngine), m_FOV(fov)
 {
 }
 //------------------------------------------------------------------------
 void InfoMaxConstrained::test(const cv::Mat &snapshot, degree_t snapshotHeading, degree_t nearestRouteHeading)
 {
-    // Get vector of differences from InfoMax
-    const auto &allDifferences = getInfoMax().getImageDifferences(snapshot);
+    // Get ranges of columns within FOV
+    const auto columnRanges = getFOVColumnRanges(getImageSize().width, snapshotHeading, nearestRouteHeading, m_FOV);
+
+    // Get familiarity at each of these rotations
+    std::vector<float> differences;
+    getInfoMaxEngine().calculateImageDifferences(snapshot, columnRanges, differences);
 
-    // Loop through snapshots
-    // **NOTE** this currently uses a super-naive approach as more efficient solution is non-trivial because
-    // columns that represent the rotations are not necessarily contiguous - there is a dis-continuity in the middle
+    // Loop through rotations
     setLowestDifference(std::numeric_limits<float>::max());
     setBestHeading(0_deg);
-    for(size_t i = 0; i < allDifferences.size(); i++) {
-        // If this snapshot is a better match than current best
-        if(allDifferences[i] < getLowestDifference()) {
-            // Convert column into pixel rotation
-            int pixelRotation = i;
-            if(pixelRotation > (getImageSize().width / 2)) {
-                pixelRotation -= getImageSize().width;
-            }
-
-            // Convert this into angle
-            const degree_t heading = snapshotHeading + turn_t((double)pixelRotation / (double)getImageSize().width);
-
-            // If the distance between this angle from grid and route angle is within FOV, update best
-            if(fabs(shortestAngleBetween(heading, nearestRouteHeading)) < m_FOV) {
-                setBestHeading(heading);
-                setLowestDifference(allDifferences[i]);
+    for(const auto &r : columnRanges) {
+        for(int c = r.first; c < r.second; c++) {
+            // If this rotation is a better match than current best, update best
+            const float difference = differences[c];
+            if(difference < getLowestDifference()) {
+                setBestHeading(getColumnHeading(c, getImageSize().width, snapshotHeading));
+                setLowestDifference(difference);
             }
         }
     }
@@ -279,3 +594,8 @@ void InfoMaxConstrained::test(const cv::Mat &snapshot, degree_t snapshotHeading,
     // **TODO** calculate vector length
     setVectorLength(1.0f);
 }
+//------------------------------------------------------------------------
+std::unique_ptr<MemoryBase> InfoMaxConstrained::clone() const
+{
+    return std::unique_ptr<MemoryBase>(new InfoMaxConstrained(*this));
+}
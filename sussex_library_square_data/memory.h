@@ -1,5 +1,8 @@
 #pragma once
 
+// Standard C++ includes
+#include <memory>
+
 // BoB robotics 3rd party includes
 #include "third_party/units.h"
 
@@ -9,6 +12,14 @@
 #include "navigation/perfect_memory.h"
 #include "navigation/perfect_memory_store_raw.h"
 
+#include "hnsw_index.h"
+#include "infomax_engine.h"
+#include "infomax_weights.h"
+#include "ridf_engine.h"
+
+// Forward declarations
+class SnapshotCache;
+
 inline units::angle::degree_t shortestAngleBetween(units::angle::degree_t x, units::angle::degree_t y)
 {
     return units::math::atan2(units::math::sin(x - y), units::math::cos(x - y));
@@ -27,6 +38,15 @@ public:
     //------------------------------------------------------------------------
     virtual void test(const cv::Mat &snapshot, units::angle::degree_t snapshotHeading, units::angle::degree_t nearestRouteHeading) = 0;
     virtual std::vector<float> calculateRIDF(const cv::Mat &snapshot) const = 0;
+
+    // Create a copy of this memory to test with on another thread. The copy shares this memory's trained
+    // snapshots or weights but has its own scratch buffers and test results
+    virtual std::unique_ptr<MemoryBase> clone() const = 0;
+
+    // Does the result of each test depend on the points previously tested? If so, points must be tested
+    // in order by a single memory rather than spread across copies
+    virtual bool isOrderDependent() const{ return false; }
+
     virtual void writeCSVHeader(std::ostream &os);
     virtual void writeCSVLine(std::ostream &os, units::length::centimeter_t snapshotX, units::length::centimeter_t snapshotY, units::angle::degree_t angularError);
     virtual void render(cv::Mat &, units::length::centimeter_t, units::length::centimeter_t)
@@ -67,13 +87,15 @@ class PerfectMemory : public MemoryBase
 {
 public:
     PerfectMemory(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route,
-                  bool renderGoodMatches, bool renderBadMatches);
+                  bool renderGoodMatches, bool renderBadMatches, const std::string &ridfEngine = RIDFEngine::defaultName,
+                  size_t prefilterCandidates = 0);
 
     //------------------------------------------------------------------------
     // MemoryBase virtuals
     //------------------------------------------------------------------------
     virtual void test(const cv::Mat &snapshot, units::angle::degree_t snapshotHeading, units::angle::degree_t) override;
     virtual std::vector<float> calculateRIDF(const cv::Mat &snapshot) const override;
+    virtual std::unique_ptr<MemoryBase> clone() const override;
     virtual void writeCSVHeader(std::ostream &os);
     virtual void writeCSVLine(std::ostream &os, units::length::centimeter_t snapshotX, units::length::centimeter_t snapshotY, units::angle::degree_t angularError);
     virtual void render(cv::Mat &image, units::length::centimeter_t snapshotX, units::length::centimeter_t snapshotY);
@@ -84,10 +106,17 @@ public:
     size_t getBestSnapshotIndex() const{ return m_BestSnapshotIndex; }
 
 protected:
+    // Train on snapshots already resized from route
+    PerfectMemory(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route, const SnapshotCache &snapshots,
+                  bool renderGoodMatches, bool renderBadMatches, const std::string &ridfEngine, size_t prefilterCandidates);
+
+    // Copy memory, sharing trained snapshots with it
+    PerfectMemory(const PerfectMemory &other);
+
     //------------------------------------------------------------------------
     // Protected API
     //------------------------------------------------------------------------
-    const BoBRobotics::Navigation::PerfectMemoryRotater<> &getPM() const{ return m_PM; }
+    const RIDFEngine &getRIDFEngine() const{ return *m_RIDFEngine; }
 
     void setBestSnapshotIndex(size_t bestSnapshotIndex){ m_BestSnapshotIndex = bestSnapshotIndex; }
 
@@ -95,7 +124,7 @@ private:
     //------------------------------------------------------------------------
     // Members
     //------------------------------------------------------------------------
-    BoBRobotics::Navigation::PerfectMemoryRotater<> m_PM;
+    std::unique_ptr<RIDFEngine> m_RIDFEngine;
     const BoBRobotics::Navigation::ImageDatabase &m_Route;
     size_t m_BestSnapshotIndex;
     const bool m_RenderGoodMatches;
@@ -110,10 +139,12 @@ class PerfectMemoryConstrained : public PerfectMemory
 {
 public:
     PerfectMemoryConstrained(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route, units::angle::degree_t fov,
-                             bool renderGoodMatches, bool renderBadMatches);
+                             bool renderGoodMatches, bool renderBadMatches, const std::string &ridfEngine = RIDFEngine::defaultName,
+                             size_t prefilterCandidates = 0);
 
 
     virtual void test(const cv::Mat &snapshot, units::angle::degree_t snapshotHeading, units::angle::degree_t nearestRouteHeading) override;
+    virtual std::unique_ptr<MemoryBase> clone() const override;
 
 private:
     //------------------------------------------------------------------------
@@ -122,40 +153,158 @@ private:
     const units::angle::degree_t m_FOV;
 };
 
+//------------------------------------------------------------------------
+// PerfectMemoryANN
+//------------------------------------------------------------------------
+// Perfect Memory which shortlists snapshots using an HNSW index over their sorted rows - a rotation-invariant
+// signature - and then only compares the numCandidates snapshots on the shortlist at every rotation. Query cost
+// grows roughly logarithmically with route length but, because the shortlist is approximate, the best match
+// may differ from PerfectMemory's
+class PerfectMemoryANN : public PerfectMemory
+{
+public:
+    PerfectMemoryANN(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route,
+                     bool renderGoodMatches, bool renderBadMatches, const std::string &ridfEngine = RIDFEngine::defaultName,
+                     size_t numCandidates = 10, size_t efSearch = 64);
+
+    virtual void test(const cv::Mat &snapshot, units::angle::degree_t snapshotHeading, units::angle::degree_t) override;
+    virtual std::unique_ptr<MemoryBase> clone() const override;
+
+private:
+    // Train on and index snapshots already resized from route, so they are only loaded once
+    PerfectMemoryANN(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route, const SnapshotCache &snapshots,
+                     bool renderGoodMatches, bool renderBadMatches, const std::string &ridfEngine,
+                     size_t numCandidates, size_t efSearch);
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // Number of snapshots to shortlist and width of beam used to search index
+    const size_t m_NumCandidates;
+    const size_t m_EFSearch;
+
+    // Index, shared with copies of memory
+    std::shared_ptr<const HNSWIndex> m_Index;
+
+    // Scratch buffers
+    std::vector<uint8_t> m_ScratchSortedImage;
+    std::vector<size_t> m_ScratchCandidates;
+    HNSWIndex::VisitMarks m_ScratchVisitMarks;
+};
+
+//------------------------------------------------------------------------
+// PerfectMemorySequence
+//------------------------------------------------------------------------
+// Perfect Memory which assumes the best matching snapshot moves smoothly along the route so only compares snapshots
+// within windowSize of the previous best match. If the lowest difference found is above differenceThreshold, the
+// window is repeatedly doubled until it is not or the window covers the whole route, only comparing the snapshots
+// added to the window each time. The first test searches the whole route. **NOTE** results depend on the order
+// points are tested in
+class PerfectMemorySequence : public PerfectMemory
+{
+public:
+    PerfectMemorySequence(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route,
+                          bool renderGoodMatches, bool renderBadMatches, const std::string &ridfEngine = RIDFEngine::defaultName,
+                          size_t windowSize = 10, float differenceThreshold = 0.1f);
+
+    virtual void test(const cv::Mat &snapshot, units::angle::degree_t snapshotHeading, units::angle::degree_t) override;
+    virtual std::unique_ptr<MemoryBase> clone() const override;
+    virtual bool isOrderDependent() const override{ return true; }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // Number of snapshots either side of previous best match to search initially
+    const size_t m_WindowSize;
+
+    // Scaled difference above which window is widened
+    const float m_DifferenceThreshold;
+
+    // Scratch buffer
+    std::vector<size_t> m_ScratchCandidates;
+};
+
+//------------------------------------------------------------------------
+// InfoMaxTrainingParameters
+//------------------------------------------------------------------------
+// Parameters used to train InfoMax weights if no matching weight file exists
+struct InfoMaxTrainingParameters
+{
+    // Learning rate used by BoB robotics' InfoMaxRotater and to train legacy weight files
+    static constexpr float defaultLearningRate = 0.0001f;
+
+    float learningRate = defaultLearningRate;
+
+    // Number of snapshots whose updates are calculated from the same weights and applied together.
+    // If zero, snapshots are trained on one at a time by BoB robotics' InfoMaxRotater
+    size_t batchSize = 0;
+
+    // Number of passes through route - only used for minibatch training
+    size_t numEpochs = 1;
+
+    // Seed for initial weights - only used for minibatch training
+    unsigned int seed = 0;
+
+    // Number of threads used for loading snapshots and matrix products
+    unsigned int numThreads = 1;
+};
+
 //------------------------------------------------------------------------
 // InfoMax
 //------------------------------------------------------------------------
 class InfoMax : public MemoryBase
 {
     using InfoMaxType = BoBRobotics::Navigation::InfoMaxRotater<BoBRobotics::Navigation::InSilicoRotater, float>;
-    using InfoMaxWeightMatrixType = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic>;
 
 public:
-    InfoMax(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route);
+    InfoMax(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route,
+            const InfoMaxTrainingParameters &trainingParameters = InfoMaxTrainingParameters(),
+            const std::string &infoMaxEngine = "Direct");
 
     virtual void test(const cv::Mat &snapshot, units::angle::degree_t snapshotHeading, units::angle::degree_t) override;
     virtual std::vector<float> calculateRIDF(const cv::Mat &snapshot) const override;
+    virtual std::unique_ptr<MemoryBase> clone() const override;
+
+    //------------------------------------------------------------------------
+    // Static API
+    //------------------------------------------------------------------------
+    // Train weights on route using minibatches of trainingParameters.batchSize snapshots. Each minibatch applies the
+    // sum of the updates InfoMaxRotater would make for each snapshot, calculated from the same weights with matrix-matrix
+    // products, so the cost of multiplying the update by the weights is shared across the batch. Reports throughput and
+    // convergence (relative change in weights and mean familiarity of route snapshots) after each epoch
+    static InfoMaxWeights::MatrixType trainWeights(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route,
+                                                   const InfoMaxTrainingParameters &trainingParameters);
 
 protected:
+    // Copy memory, sharing weights with it
+    InfoMax(const InfoMax &other);
+
     //------------------------------------------------------------------------
     // Protected API
     //------------------------------------------------------------------------
-    const InfoMaxType &getInfoMax() const{ return m_InfoMax; }
+    const InfoMaxEngine &getInfoMaxEngine() const{ return *m_InfoMaxEngine; }
 
 private:
     //------------------------------------------------------------------------
     // Static API
     //------------------------------------------------------------------------
-    // **TODO** move into BoB robotics
-    static void writeWeights(const InfoMaxWeightMatrixType &weights, const filesystem::path &weightPath);
-    // **TODO** move into BoB robotics
-    static InfoMaxWeightMatrixType readWeights(const filesystem::path &weightPath);
-    static InfoMaxType createInfoMax(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route);
+    // Map weights trained on route from weight file alongside it, training and writing them if necessary. Weight files
+    // are named by a hash of the image size, the route's path and images and the learning parameters so weights
+    // trained with different settings sit side by side and are never loaded for the wrong settings. If there is no such
+    // file, weights from a legacy weight file are imported but flagged as unverified
+    static std::unique_ptr<InfoMaxWeights> createWeights(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route,
+                                                         const InfoMaxTrainingParameters &trainingParameters);
+
+    // Generate random initial weights in the same way as InfoMaxRotater
+    static InfoMaxWeights::MatrixType generateInitialWeights(int numInputs, int numHidden, unsigned int seed);
 
     //------------------------------------------------------------------------
     // Members
     //------------------------------------------------------------------------
-    InfoMaxType m_InfoMax;
+    // Weights, shared with copies of memory
+    std::shared_ptr<const InfoMaxWeights> m_Weights;
+    std::unique_ptr<InfoMaxEngine> m_InfoMaxEngine;
 };
 
 //------------------------------------------------------------------------
@@ -164,9 +313,12 @@ private:
 class InfoMaxConstrained : public InfoMax
 {
 public:
-    InfoMaxConstrained(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route, units::angle::degree_t fov);
+    InfoMaxConstrained(const cv::Size &imSize, const BoBRobotics::Navigation::ImageDatabase &route, units::angle::degree_t fov,
+                       const InfoMaxTrainingParameters &trainingParameters = InfoMaxTrainingParameters(),
+                       const std::string &infoMaxEngine = "Direct");
 
     virtual void test(const cv::Mat &snapshot, units::angle::degree_t snapshotHeading, units::angle::degree_t nearestRouteHeading) override;
+    virtual std::unique_ptr<MemoryBase> clone() const override;
 
 private:
     //------------------------------------------------------------------------
@@ -0,0 +1,84 @@
+#include "memory_factory.h"
+
+// Standard C++ includes
+#include <stdexcept>
+
+// CLI11 includes
+#include "CLI11.hpp"
+
+#include "profiler.h"
+
+using namespace BoBRobotics;
+using namespace units::angle;
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+void addMemoryOptions(CLI::App &app, MemoryParameters &parameters)
+{
+    app.add_option("--fov", parameters.fovDegrees,
+                   "For 'constrained' memories, what angle (in degrees) on either side of route should snapshots be matched in", true);
+    app.add_set("--ridf-engine", parameters.ridfEngine, {"Direct", "Fused", "EarlyAbandon", "Prefilter", "FFT"},
+                "For Perfect Memory types, how to compare images at every rotation", true);
+    app.add_flag("--allow-rms", parameters.allowRMS,
+                 "For Perfect Memory types, allow the FFT RIDF engine, which calculates root mean square rather than mean absolute differences");
+    app.add_set("--infomax-engine", parameters.infoMaxEngine, {"Direct", "GEMM", "FP16", "Int8", "FFT"},
+                "For InfoMax types, how to calculate familiarity at every rotation (FP16 and Int8 quantise weights when loaded)", true);
+    app.add_option("--prefilter-candidates", parameters.prefilterCandidates,
+                   "For the Prefilter RIDF engine, how many snapshots to compare at every rotation (0 for exact search)", true);
+    app.add_option("--ann-candidates", parameters.annCandidates,
+                   "For PerfectMemoryANN, how many snapshots to shortlist and compare at every rotation", true);
+    app.add_option("--ann-ef-search", parameters.annEFSearch,
+                   "For PerfectMemoryANN, width of beam used to search index (larger is slower but more accurate)", true);
+    app.add_option("--sequence-window", parameters.sequenceWindow,
+                   "For PerfectMemorySequence, how many snapshots either side of the previous best match to search", true);
+    app.add_option("--sequence-threshold", parameters.sequenceThreshold,
+                   "For PerfectMemorySequence, lowest difference above which the search window is widened", true);
+    app.add_option("--infomax-learning-rate", parameters.infoMaxTraining.learningRate,
+                   "For InfoMax types, learning rate used to train weights", true);
+    app.add_option("--infomax-batch-size", parameters.infoMaxTraining.batchSize,
+                   "For InfoMax types, number of snapshots in each minibatch used to train weights (0 to train sequentially)", true);
+    app.add_option("--infomax-epochs", parameters.infoMaxTraining.numEpochs,
+                   "For InfoMax types, number of passes through route when training weights in minibatches", true);
+}
+//------------------------------------------------------------------------
+std::unique_ptr<MemoryBase> createMemory(const std::string &memoryType, const cv::Size &imSize,
+                                         const Navigation::ImageDatabase &route, const MemoryParameters &parameters)
+{
+    // Time training or loading of each type of memory separately
+    const std::string stage = "Memory creation " + memoryType;
+    Profiler::ScopedTimer timer(stage.c_str());
+
+    // The FFT RIDF engine calculates different differences to every other so only use it if explicitly allowed
+    if(memoryType.compare(0, 13, "PerfectMemory") == 0 && parameters.ridfEngine == "FFT" && !parameters.allowRMS) {
+        throw std::runtime_error("RIDF engine 'FFT' calculates root mean square differences - pass --allow-rms to use it");
+    }
+
+    if(memoryType == "PerfectMemory") {
+        return std::unique_ptr<MemoryBase>(new PerfectMemory(imSize, route, parameters.renderGoodMatches, parameters.renderBadMatches,
+                                                             parameters.ridfEngine, parameters.prefilterCandidates));
+    }
+    else if(memoryType == "PerfectMemoryConstrained") {
+        return std::unique_ptr<MemoryBase>(new PerfectMemoryConstrained(imSize, route, degree_t(parameters.fovDegrees),
+                                                                        parameters.renderGoodMatches, parameters.renderBadMatches,
+                                                                        parameters.ridfEngine, parameters.prefilterCandidates));
+    }
+    else if(memoryType == "PerfectMemoryANN") {
+        return std::unique_ptr<MemoryBase>(new PerfectMemoryANN(imSize, route, parameters.renderGoodMatches, parameters.renderBadMatches,
+                                                                parameters.ridfEngine, parameters.annCandidates, parameters.annEFSearch));
+    }
+    else if(memoryType == "PerfectMemorySequence") {
+        return std::unique_ptr<MemoryBase>(new PerfectMemorySequence(imSize, route, parameters.renderGoodMatches, parameters.renderBadMatches,
+                                                                     parameters.ridfEngine, parameters.sequenceWindow, parameters.sequenceThreshold));
+    }
+    else if(memoryType == "InfoMax") {
+        return std::unique_ptr<MemoryBase>(new InfoMax(imSize, route, parameters.infoMaxTraining, parameters.infoMaxEngine));
+    }
+    else if(memoryType == "InfoMaxConstrained") {
+        return std::unique_ptr<MemoryBase>(new InfoMaxConstrained(imSize, route, degree_t(parameters.fovDegrees),
+                                                                  parameters.infoMaxTraining, parameters.infoMaxEngine));
+    }
+    else {
+        throw std::runtime_error("Memory type '" + memoryType + "' not supported");
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+// Standard C++ includes
+#include <memory>
+#include <string>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// BoB robotics includes
+#include "navigation/image_database.h"
+
+#include "memory.h"
+
+// Forward declarations
+namespace CLI
+{
+class App;
+}
+
+//------------------------------------------------------------------------
+// MemoryParameters
+//------------------------------------------------------------------------
+// Options used to create memories of any type - each is only used by the types it applies to
+struct MemoryParameters
+{
+    // For 'constrained' memories, angle (in degrees) on either side of route snapshots are matched in
+    double fovDegrees = 90.0;
+
+    // For Perfect Memory types, whether lines are rendered to good and bad matches
+    bool renderGoodMatches = true;
+    bool renderBadMatches = false;
+
+    // For Perfect Memory types, RIDF engine and its options
+    std::string ridfEngine = RIDFEngine::defaultName;
+
+    // For Perfect Memory types, whether RIDF engines which calculate root mean square rather than mean absolute
+    // differences, and therefore give different results, can be used
+    bool allowRMS = false;
+    size_t prefilterCandidates = 0;
+    size_t annCandidates = 10;
+    size_t annEFSearch = 64;
+    size_t sequenceWindow = 10;
+    float sequenceThreshold = 0.1f;
+
+    // For InfoMax types, InfoMax engine and training parameters
+    std::string infoMaxEngine = "Direct";
+    InfoMaxTrainingParameters infoMaxTraining;
+};
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+// Add command line options to configure memory parameters
+void addMemoryOptions(CLI::App &app, MemoryParameters &parameters);
+
+// Create memory by type name, trained on route
+std::unique_ptr<MemoryBase> createMemory(const std::string &memoryType, const cv::Size &imSize,
+                                         const BoBRobotics::Navigation::ImageDatabase &route,
+                                         const MemoryParameters &parameters);
@@ -0,0 +1,272 @@
+// Standard C++ includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// BoB robotics 3rd party includes
+#include "third_party/path.h"
+
+// BoB robotics includes
+#include "navigation/image_database.h"
+
+// CLI11 includes
+#include "CLI11.hpp"
+
+#include "psimpl.h"
+
+#include "memory.h"
+#include "route.h"
+#include "snapshot_cache.h"
+
+using namespace BoBRobotics;
+using namespace units::literals;
+using namespace units::length;
+using namespace units::angle;
+using namespace units::math;
+
+//------------------------------------------------------------------------
+// Anonymous namespace
+//------------------------------------------------------------------------
+namespace
+{
+// Result of timing one benchmark with one set of parameters
+struct MicrobenchmarkResult
+{
+    std::string name;
+    cv::Size imageSize;
+    size_t memorySize;
+    size_t iterations;
+    double nsPerOp;
+    double bytesPerOp;
+};
+
+// Run operation, doubling the number of iterations until they take at least minimumTime, and report time per
+// operation. bytesPerOp is the amount of data each operation reads - images, weights or route points
+MicrobenchmarkResult runMicrobenchmark(const std::string &name, const cv::Size &imageSize, size_t memorySize,
+                                       double bytesPerOp, double minimumTime, const std::function<void(size_t)> &operation)
+{
+    // Warm caches
+    operation(0);
+
+    size_t iterations = 1;
+    while(true) {
+        const auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < iterations; i++) {
+            operation(i);
+        }
+        const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+        if(time.count() >= minimumTime) {
+            const MicrobenchmarkResult result{name, imageSize, memorySize, iterations,
+                                              (time.count() * 1.0E9) / (double)iterations, bytesPerOp};
+            std::cout << std::left << std::setw(48) << name << std::right << std::setw(4) << imageSize.width << "x" << std::setw(3) << imageSize.height
+                << std::setw(8) << memorySize << std::setw(16) << std::fixed << std::setprecision(1) << result.nsPerOp << " ns/op"
+                << std::setw(16) << bytesPerOp << " B/op" << std::endl;
+            return result;
+        }
+        iterations *= 2;
+    }
+}
+
+// Check familiarity calculated by infoMax matches that calculated by reference on numImages snapshots spread across
+// snapshots, to within relative tolerance, throwing if it does not
+void checkInfoMax(const InfoMax &reference, const InfoMax &infoMax, const std::string &name,
+                  const SnapshotCache &snapshots, size_t numImages, float tolerance)
+{
+    float maxRelativeError = 0.0f;
+    for(size_t i = 0; i < numImages; i++) {
+        const cv::Mat snapshot = snapshots[(i * snapshots.size()) / numImages];
+        const auto expected = reference.calculateRIDF(snapshot);
+        const auto actual = infoMax.calculateRIDF(snapshot);
+        for(size_t c = 0; c < expected.size(); c++) {
+            maxRelativeError = std::max(maxRelativeError, std::fabs(actual[c] - expected[c]) / std::fabs(expected[c]));
+        }
+    }
+
+    std::cout << name << " max relative error " << maxRelativeError << std::endl;
+    if(maxRelativeError > tolerance) {
+        throw std::runtime_error(name + " does not match reference");
+    }
+}
+
+// Write results as JSON, one result per line so results from different builds can be diffed
+void writeJSON(std::ostream &os, const std::vector<MicrobenchmarkResult> &results)
+{
+    os << "[" << std::endl;
+    for(size_t r = 0; r < results.size(); r++) {
+        const auto &result = results[r];
+        os << "  {\"name\": \"" << result.name << "\", \"imageWidth\": " << result.imageSize.width
+            << ", \"imageHeight\": " << result.imageSize.height << ", \"memorySize\": " << result.memorySize
+            << ", \"iterations\": " << result.iterations << std::fixed << std::setprecision(1) << ", \"nsPerOp\": " << result.nsPerOp
+            << ", \"bytesPerOp\": " << result.bytesPerOp << "}" << ((r == (results.size() - 1)) ? "" : ",") << std::endl;
+    }
+    os << "]" << std::endl;
+}
+}   // Anonymous namespace
+
+int main(int argc, char **argv)
+{
+    // Default command line arguments
+    std::vector<std::string> imageSizeNames{"120x25", "720x1", "360x75"};
+    std::vector<std::string> routeNames{"route1", "route3", "route5"};
+    std::string variantName = "skymask";
+    std::string imageGridName = "mid_day";
+    std::string outputJSONName = "";
+    double decimateDistance = 15.0;
+    double fovDegrees = 90.0;
+    double minimumTime = 0.5;
+    int maxInfoMaxInputs = 10000;
+
+    // Configure command line parser
+    CLI::App app{"BoB robotics navigation microbenchmarks"};
+    app.add_option("--image-sizes", imageSizeNames, "Image sizes to benchmark, as WIDTHxHEIGHT", true);
+    app.add_option("--routes", routeNames, "Routes to train memories on - the number of snapshots in each sets the memory size", true);
+    app.add_option("--variant", variantName, "Variant of routes and grid to use", true);
+    app.add_option("--grid", imageGridName, "Name of image grid whose images are tested", true);
+    app.add_option("--output-json", outputJSONName, "Name of JSON file to write results to", true);
+    app.add_option("--decimate-distance", decimateDistance, "Threshold (in cm) for decimating route points", true);
+    app.add_option("--fov", fovDegrees, "FOV (in degrees) used by PerfectMemoryConstrained", true);
+    app.add_option("--min-time", minimumTime, "Minimum time (in seconds) to run each benchmark for", true);
+    app.add_option("--max-infomax-inputs", maxInfoMaxInputs,
+                   "InfoMax benchmarks are skipped for image sizes with more pixels than this as weights grow with its square", true);
+
+    // Parse command line arguments
+    CLI11_PARSE(app, argc, argv);
+
+    // Parse image sizes
+    std::vector<cv::Size> imageSizes;
+    for(const auto &s : imageSizeNames) {
+        const size_t separator = s.find('x');
+        if(separator == std::string::npos) {
+            throw std::runtime_error("Image size '" + s + "' is not formatted as WIDTHxHEIGHT");
+        }
+        imageSizes.emplace_back(std::stoi(s.substr(0, separator)), std::stoi(s.substr(separator + 1)));
+    }
+
+    // Load grid, used as test images, and get positions of grid points
+    Navigation::ImageDatabase grid = filesystem::path("image_grids") / imageGridName / variantName;
+    std::vector<cv::Point2f> gridPoints;
+    for(const auto &g : grid) {
+        const centimeter_t x = g.position[0];
+        const centimeter_t y = g.position[1];
+        gridPoints.emplace_back(x.value(), y.value());
+    }
+
+    std::vector<MicrobenchmarkResult> results;
+    for(const auto &routeName : routeNames) {
+        const filesystem::path routePath = filesystem::path("routes") / routeName / variantName;
+        Navigation::ImageDatabase route(routePath);
+        const size_t memorySize = route.size();
+
+        // Route processing doesn't depend on image size
+        const cv::Size noImage(0, 0);
+        std::vector<float> routePointComponents;
+        for(const auto &r : route) {
+            const centimeter_t x = r.position[0];
+            const centimeter_t y = r.position[1];
+            routePointComponents.push_back(x.value());
+            routePointComponents.push_back(y.value());
+        }
+        results.push_back(runMicrobenchmark("psimpl::simplify_douglas_peucker", noImage, memorySize,
+                                            (double)(routePointComponents.size() * sizeof(float)), minimumTime,
+                                            [&routePointComponents, decimateDistance](size_t)
+                                            {
+                                                std::vector<float> decimated;
+                                                psimpl::simplify_douglas_peucker<2>(routePointComponents.cbegin(), routePointComponents.cend(),
+                                                                                    decimateDistance, std::back_inserter(decimated));
+                                            }));
+
+        std::vector<cv::Point2f> decimatedRoutePoints;
+        results.push_back(runMicrobenchmark("processRoute", noImage, memorySize,
+                                            (double)(routePointComponents.size() * sizeof(float)), minimumTime,
+                                            [&route, &decimatedRoutePoints, decimateDistance](size_t)
+                                            {
+                                                cv::Mat routePointsMat;
+                                                cv::Mat decimatedRoutePointMat;
+                                                decimatedRoutePoints.clear();
+                                                processRoute(route, decimateDistance, routePointsMat, decimatedRoutePointMat, decimatedRoutePoints);
+                                            }));
+
+        results.push_back(runMicrobenchmark("getNearestPointOnRoute", noImage, decimatedRoutePoints.size(),
+                                            (double)(decimatedRoutePoints.size() * sizeof(cv::Point2f)), minimumTime,
+                                            [&gridPoints, &decimatedRoutePoints](size_t i)
+                                            {
+                                                getNearestPointOnRoute(gridPoints[i % gridPoints.size()], decimatedRoutePoints);
+                                            }));
+
+        for(const auto &imSize : imageSizes) {
+            const SnapshotCache gridSnapshots(grid, imSize);
+            const double snapshotBytes = (double)imSize.area();
+            const double memoryBytes = snapshotBytes * (double)memorySize;
+
+            // Test against grid snapshots in turn with grid headings
+            auto getSnapshot = [&gridSnapshots](size_t i){ return gridSnapshots[i % gridSnapshots.size()]; };
+            auto getHeading = [&grid](size_t i){ return grid[i % grid.size()].heading; };
+
+            {
+                PerfectMemory perfectMemory(imSize, route, false, false);
+                results.push_back(runMicrobenchmark("PerfectMemory::test", imSize, memorySize, memoryBytes, minimumTime,
+                                                    [&](size_t i){ perfectMemory.test(getSnapshot(i), getHeading(i), 0_deg); }));
+                results.push_back(runMicrobenchmark("PerfectMemory::calculateRIDF", imSize, memorySize, memoryBytes, minimumTime,
+                                                    [&](size_t i){ perfectMemory.calculateRIDF(getSnapshot(i)); }));
+            }
+
+            {
+                // Grid headings are used as the nearest route heading so roughly 'fov' worth of columns are compared
+                PerfectMemoryConstrained perfectMemory(imSize, route, degree_t(fovDegrees), false, false);
+                results.push_back(runMicrobenchmark("PerfectMemoryConstrained::test", imSize, memorySize, memoryBytes, minimumTime,
+                                                    [&](size_t i){ perfectMemory.test(getSnapshot(i), getHeading(i), getHeading(i)); }));
+            }
+
+            if(imSize.area() <= maxInfoMaxInputs) {
+                // Construct once so weights are trained and written if necessary
+                InfoMax infoMax(imSize, route);
+
+                const double weightBytes = (double)imSize.area() * (double)imSize.area() * sizeof(float);
+                results.push_back(runMicrobenchmark("InfoMax::InfoMax (cached weights)", imSize, memorySize, weightBytes, minimumTime,
+                                                    [&](size_t){ InfoMax loadedInfoMax(imSize, route); }));
+
+                // Check exact engines match InfoMaxRotater on grid snapshots, to within float rounding
+                {
+                    const InfoMax directInfoMax(imSize, route, InfoMaxTrainingParameters(), "Direct");
+                    for(const std::string e : {"GEMM", "FFT"}) {
+                        const InfoMax engineInfoMax(imSize, route, InfoMaxTrainingParameters(), e);
+                        checkInfoMax(directInfoMax, engineInfoMax, "InfoMax (" + e + ")", gridSnapshots,
+                                     std::min<size_t>(10, gridSnapshots.size()), 1.0E-3f);
+                    }
+                }
+
+                // Test with each engine, reading weights in each engine's format
+                const std::vector<std::pair<std::string, double>> engineBytesPerWeight{
+                    {"Direct", sizeof(float)}, {"GEMM", sizeof(float)}, {"FP16", sizeof(uint16_t)}, {"Int8", sizeof(int8_t)}, {"FFT", sizeof(float)}};
+                for(const auto &e : engineBytesPerWeight) {
+                    InfoMax engineInfoMax(imSize, route, InfoMaxTrainingParameters(), e.first);
+                    const double engineWeightBytes = (double)imSize.area() * (double)imSize.area() * e.second;
+                    results.push_back(runMicrobenchmark("InfoMax::test (" + e.first + ")", imSize, memorySize, engineWeightBytes, minimumTime,
+                                                        [&](size_t i){ engineInfoMax.test(getSnapshot(i), getHeading(i), 0_deg); }));
+                }
+            }
+            else {
+                std::cout << "Skipping InfoMax benchmarks at " << imSize.width << "x" << imSize.height << std::endl;
+            }
+        }
+    }
+
+    // Write JSON
+    if(!outputJSONName.empty()) {
+        std::ofstream outputJSON(outputJSONName);
+        writeJSON(outputJSON, results);
+    }
+
+    return EXIT_SUCCESS;
+}
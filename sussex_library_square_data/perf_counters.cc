@@ -0,0 +1,203 @@
+#include "perf_counters.h"
+
+// Standard C++ includes
+#include <cerrno>
+#include <cstring>
+
+// POSIX includes
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Linux includes
+#include <linux/perf_event.h>
+
+//------------------------------------------------------------------------
+// Anonymous namespace
+//------------------------------------------------------------------------
+namespace
+{
+// Generic hardware events corresponding to each counter
+const uint64_t s_CounterEvents[PerfCounterValues::CounterMax] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_REFERENCES,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES};
+
+// Size of cache line, used to estimate memory traffic from cache misses
+const double s_CacheLineBytes = 64.0;
+
+// Open counter, as the leader of a new group if groupFileDescriptor is -1 or otherwise as a member of the group
+int openCounter(uint64_t event, bool inherit, int groupFileDescriptor)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = event;
+    attr.disabled = (groupFileDescriptor == -1) ? 1 : 0;
+    attr.inherit = inherit ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // Count calling thread on any CPU
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFileDescriptor, 0);
+}
+
+// Write ratio of two counters or NA if either is unavailable
+void writeRatio(std::ostream &os, const PerfCounterValues &values, PerfCounterValues::Counter numerator,
+                PerfCounterValues::Counter denominator)
+{
+    if(values.available[numerator] && values.available[denominator] && values.counts[denominator] > 0) {
+        os << (double)values.counts[numerator] / (double)values.counts[denominator];
+    }
+    else {
+        os << "NA";
+    }
+}
+}   // Anonymous namespace
+
+//------------------------------------------------------------------------
+// PerfCounterValues
+//------------------------------------------------------------------------
+PerfCounterValues &PerfCounterValues::operator += (const PerfCounterValues &other)
+{
+    for(int c = 0; c < CounterMax; c++) {
+        counts[c] += other.counts[c];
+        available[c] = available[c] || other.available[c];
+    }
+    enabledTime += other.enabledTime;
+    return *this;
+}
+//------------------------------------------------------------------------
+void PerfCounterValues::writeCSV(std::ostream &os) const
+{
+    for(int c = 0; c < CounterMax; c++) {
+        if(available[c]) {
+            os << counts[c] << ", ";
+        }
+        else {
+            os << "NA, ";
+        }
+    }
+    os << enabledTime << ", ";
+
+    writeRatio(os, *this, Instructions, Cycles);
+    os << ", ";
+    writeRatio(os, *this, CacheMisses, CacheReferences);
+    os << ", ";
+    writeRatio(os, *this, BranchMisses, Branches);
+    os << ", ";
+
+    if(available[CacheMisses] && enabledTime > 0.0) {
+        os << ((double)counts[CacheMisses] * s_CacheLineBytes) / (enabledTime * 1.0E9);
+    }
+    else {
+        os << "NA";
+    }
+}
+//------------------------------------------------------------------------
+void PerfCounterValues::writeCSVHeader(std::ostream &os)
+{
+    os << "cycles, instructions, cache references, cache misses, branches, branch misses, counted time [s], "
+        << "IPC, cache miss rate, branch miss rate, estimated memory bandwidth per thread [GB/s]";
+}
+
+//------------------------------------------------------------------------
+// PerfCounters
+//------------------------------------------------------------------------
+PerfCounters::PerfCounters(bool inherit)
+:   m_GroupFileDescriptor(-1)
+{
+    // Open counters as one group, led by the first which can be opened
+    for(int c = 0; c < PerfCounterValues::CounterMax; c++) {
+        m_FileDescriptors[c] = openCounter(s_CounterEvents[c], inherit, m_GroupFileDescriptor);
+        if(m_GroupFileDescriptor == -1) {
+            m_GroupFileDescriptor = m_FileDescriptors[c];
+        }
+    }
+}
+//------------------------------------------------------------------------
+PerfCounters::~PerfCounters()
+{
+    // Close group members before leader
+    for(int c = PerfCounterValues::CounterMax - 1; c >= 0; c--) {
+        if(m_FileDescriptors[c] >= 0) {
+            close(m_FileDescriptors[c]);
+        }
+    }
+}
+//------------------------------------------------------------------------
+void PerfCounters::enable()
+{
+    if(m_GroupFileDescriptor >= 0) {
+        ioctl(m_GroupFileDescriptor, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+//------------------------------------------------------------------------
+void PerfCounters::disable()
+{
+    if(m_GroupFileDescriptor >= 0) {
+        ioctl(m_GroupFileDescriptor, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+//------------------------------------------------------------------------
+PerfCounterValues PerfCounters::read() const
+{
+    // Read number of counters, time enabled, time running and then the value of each counter in the order they were opened
+    PerfCounterValues values;
+    uint64_t data[3 + PerfCounterValues::CounterMax];
+    if(m_GroupFileDescriptor < 0) {
+        return values;
+    }
+    const ssize_t bytesRead = ::read(m_GroupFileDescriptor, data, sizeof(data));
+    if(bytesRead < (ssize_t)(3 * sizeof(uint64_t)) || bytesRead != (ssize_t)((3 + data[0]) * sizeof(uint64_t))) {
+        return values;
+    }
+
+    // If group was never scheduled, nothing was counted
+    const uint64_t timeEnabled = data[1];
+    const uint64_t timeRunning = data[2];
+    values.enabledTime = (double)timeEnabled / 1.0E9;
+    if(timeEnabled > 0 && timeRunning == 0) {
+        return values;
+    }
+
+    // Scale counts to account for time group wasn't scheduled if the hardware is oversubscribed
+    size_t v = 0;
+    for(int c = 0; c < PerfCounterValues::CounterMax; c++) {
+        if(m_FileDescriptors[c] >= 0 && v < data[0]) {
+            const uint64_t value = data[3 + v++];
+            values.available[c] = true;
+            values.counts[c] = (timeRunning > 0 && timeRunning < timeEnabled)
+                ? (uint64_t)((double)value * ((double)timeEnabled / (double)timeRunning)) : value;
+        }
+    }
+    return values;
+}
+//------------------------------------------------------------------------
+bool PerfCounters::isAvailable() const
+{
+    for(int fd : m_FileDescriptors) {
+        if(fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+//------------------------------------------------------------------------
+bool PerfCounters::checkAvailable(std::string &reason)
+{
+    const int fd = openCounter(PERF_COUNT_HW_INSTRUCTIONS, false, -1);
+    if(fd < 0) {
+        reason = std::strerror(errno);
+        return false;
+    }
+    else {
+        close(fd);
+        return true;
+    }
+}
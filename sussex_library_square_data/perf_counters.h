@@ -0,0 +1,85 @@
+#pragma once
+
+// Standard C++ includes
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+//------------------------------------------------------------------------
+// PerfCounterValues
+//------------------------------------------------------------------------
+// Hardware event counts and the time they were counted for, summed across threads. Counters which couldn't
+// be opened are marked as unavailable
+struct PerfCounterValues
+{
+    enum Counter
+    {
+        Cycles,
+        Instructions,
+        CacheReferences,
+        CacheMisses,
+        Branches,
+        BranchMisses,
+        CounterMax,
+    };
+
+    std::array<uint64_t, CounterMax> counts{};
+    std::array<bool, CounterMax> available{};
+
+    // Time counters were enabled for, in seconds
+    double enabledTime = 0.0;
+
+    PerfCounterValues &operator += (const PerfCounterValues &other);
+
+    // Write counts, enabled time and derived metrics - IPC, miss rates and memory bandwidth, estimated from last-level
+    // cache misses over the time counters were enabled - as CSV columns, writing NA for anything which couldn't be counted.
+    // **NOTE** as enabled time is summed across threads, bandwidth is the average of each counted thread's
+    void writeCSV(std::ostream &os) const;
+
+    static void writeCSVHeader(std::ostream &os);
+};
+
+//------------------------------------------------------------------------
+// PerfCounters
+//------------------------------------------------------------------------
+// Hardware performance counters for the calling thread, opened using perf_event_open as one group so they are always
+// scheduled together and their ratios are consistent. Counters are created disabled and accumulate while enabled, so
+// work can be counted in pieces. If inherit is set, threads created by the calling
+// thread after construction are also counted once they exit. Counters may be unavailable, e.g. in containers or if
+// perf_event_paranoid is too high, in which case the counters which couldn't be opened are marked as unavailable
+class PerfCounters
+{
+public:
+    PerfCounters(bool inherit = false);
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    void enable();
+    void disable();
+
+    // Read counts, scaled to account for time counters weren't scheduled if the hardware is oversubscribed
+    PerfCounterValues read() const;
+
+    // Is any counter available
+    bool isAvailable() const;
+
+    //------------------------------------------------------------------------
+    // Static API
+    //------------------------------------------------------------------------
+    // Check whether any counter can be opened, returning the reason if not
+    static bool checkAvailable(std::string &reason);
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // File descriptor of each counter and of group leader - the first counter which could be opened
+    std::array<int, PerfCounterValues::CounterMax> m_FileDescriptors;
+    int m_GroupFileDescriptor;
+};
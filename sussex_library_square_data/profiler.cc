@@ -0,0 +1,63 @@
+#include "profiler.h"
+
+// Standard C++ includes
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iterator>
+#include <numeric>
+
+//------------------------------------------------------------------------
+// Anonymous namespace
+//------------------------------------------------------------------------
+namespace
+{
+// Get percentile of sorted durations using the nearest-rank method
+double getPercentile(const std::vector<double> &sortedDurations, double percentile)
+{
+    const size_t rank = (size_t)std::ceil((percentile / 100.0) * (double)sortedDurations.size());
+    return sortedDurations[std::max<size_t>(rank, 1) - 1];
+}
+}   // Anonymous namespace
+
+//------------------------------------------------------------------------
+// Profiler
+//------------------------------------------------------------------------
+std::atomic<bool> Profiler::s_Enabled{false};
+std::mutex Profiler::s_DurationsMutex;
+std::map<std::string, std::vector<double>> Profiler::s_Durations;
+//------------------------------------------------------------------------
+void Profiler::addDuration(const std::string &stage, double duration)
+{
+    std::lock_guard<std::mutex> lock(s_DurationsMutex);
+    s_Durations[stage].push_back(duration);
+}
+//------------------------------------------------------------------------
+void Profiler::writeJSON(std::ostream &os)
+{
+    std::lock_guard<std::mutex> lock(s_DurationsMutex);
+
+    os << "{" << std::endl;
+    for(auto s = s_Durations.begin(); s != s_Durations.end(); ++s) {
+        std::vector<double> sortedDurations = s->second;
+        std::sort(sortedDurations.begin(), sortedDurations.end());
+        const double total = std::accumulate(sortedDurations.cbegin(), sortedDurations.cend(), 0.0);
+
+        // Count durations in power-of-two buckets of microseconds
+        std::map<int, size_t> histogram;
+        for(double d : sortedDurations) {
+            histogram[(int)std::ceil(std::log2(std::max(1.0, d * 1.0E6)))]++;
+        }
+
+        os << "  \"" << s->first << "\": {\"count\": " << sortedDurations.size() << std::scientific << std::setprecision(6)
+            << ", \"totalSeconds\": " << total << ", \"meanSeconds\": " << (total / (double)sortedDurations.size())
+            << ", \"minSeconds\": " << sortedDurations.front() << ", \"p50Seconds\": " << getPercentile(sortedDurations, 50.0)
+            << ", \"p95Seconds\": " << getPercentile(sortedDurations, 95.0) << ", \"p99Seconds\": " << getPercentile(sortedDurations, 99.0)
+            << ", \"maxSeconds\": " << sortedDurations.back() << ", \"histogramMicroseconds\": {";
+        for(auto h = histogram.cbegin(); h != histogram.cend(); ++h) {
+            os << ((h == histogram.cbegin()) ? "" : ", ") << "\"<=" << (1ull << h->first) << "\": " << h->second;
+        }
+        os << "}}" << ((std::next(s) == s_Durations.end()) ? "" : ",") << std::endl;
+    }
+    os << "}" << std::endl;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+// Standard C++ includes
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------
+// Profiler
+//------------------------------------------------------------------------
+// Process-wide collection of the time spent in named stages. Every time a stage is timed its duration is recorded
+// so, as well as the total, the distribution of durations - e.g. the latency of each grid point - can be reported.
+// When profiling is disabled, timing a stage only costs a check of a flag
+class Profiler
+{
+public:
+    //------------------------------------------------------------------------
+    // ScopedTimer
+    //------------------------------------------------------------------------
+    // Records time between construction and destruction (or stop being called) against stage
+    class ScopedTimer
+    {
+    public:
+        ScopedTimer(const char *stage)
+        :   m_Stage(isEnabled() ? stage : nullptr)
+        {
+            if(m_Stage != nullptr) {
+                m_Start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~ScopedTimer()
+        {
+            stop();
+        }
+
+        // Stop timing before end of scope
+        void stop()
+        {
+            if(m_Stage != nullptr) {
+                const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - m_Start;
+                addDuration(m_Stage, duration.count());
+                m_Stage = nullptr;
+            }
+        }
+
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    private:
+        //------------------------------------------------------------------------
+        // Members
+        //------------------------------------------------------------------------
+        const char *m_Stage;
+        std::chrono::steady_clock::time_point m_Start;
+    };
+
+    //------------------------------------------------------------------------
+    // Static API
+    //------------------------------------------------------------------------
+    static void setEnabled(bool enabled){ s_Enabled = enabled; }
+    static bool isEnabled(){ return s_Enabled; }
+
+    // Record duration (in seconds) of one occurrence of stage
+    static void addDuration(const std::string &stage, double duration);
+
+    // Write count, total, mean, percentiles and a histogram of the durations of every stage as JSON
+    static void writeJSON(std::ostream &os);
+
+private:
+    //------------------------------------------------------------------------
+    // Static members
+    //------------------------------------------------------------------------
+    static std::atomic<bool> s_Enabled;
+    static std::mutex s_DurationsMutex;
+    static std::map<std::string, std::vector<double>> s_Durations;
+};
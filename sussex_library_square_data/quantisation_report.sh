@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Lists of memory types and InfoMax engines to test - GEMM uses the full precision weights
+MEMORY_TYPES=( InfoMax InfoMaxConstrained )
+ENGINES=( GEMM FP16 Int8 )
+
+# Calculate vector fields for every route and variant with each engine, each in a single benchmark process which loads
+# each route and grid variant once. Any arguments are passed to ./benchmark e.g. --threads
+for e in "${ENGINES[@]}"; do
+    echo "${e}"
+    ./benchmark --memory-types "${MEMORY_TYPES[@]}" --infomax-engine=$e --output-directory=benchmark_results/quantisation_${e} "$@"
+done
+
+# Combine results, calculating how much each engine's RMSE differs from that of the full precision engine
+echo "Route name, memory type, variant, engine, RMSE, RMSE delta" > benchmark_results/quantisation.csv
+for e in "${ENGINES[@]}"; do
+    awk -F', ' -v ENGINE=$e \
+        'FNR == 1 { next }
+         NR == FNR { baseline[$1 FS $2 FS $3] = $4 + 0; next }
+         { print $1 FS $2 FS $3 FS ENGINE FS ($4 + 0) FS (($4 + 0) - baseline[$1 FS $2 FS $3]) }' \
+        benchmark_results/quantisation_GEMM/output.csv benchmark_results/quantisation_${e}/output.csv >> benchmark_results/quantisation.csv
+done
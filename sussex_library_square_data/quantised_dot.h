@@ -0,0 +1,158 @@
+#pragma once
+
+// Standard C++ includes
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "cpu_features.h"
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+// Convert float to IEEE half precision, rounding to nearest even
+inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    const int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    // NaN and infinity
+    if(((bits >> 23) & 0xFF) == 0xFF) {
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+    }
+    // Overflow to infinity
+    else if(exponent >= 31) {
+        return sign | 0x7C00;
+    }
+    // Subnormal or zero
+    else if(exponent <= 0) {
+        if(exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        const uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if(remainder > halfway || (remainder == halfway && (half & 1))) {
+            half++;
+        }
+        return sign | (uint16_t)half;
+    }
+    // Normal - rounding may carry into exponent, which correctly produces infinity on overflow
+    else {
+        uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+        const uint32_t remainder = mantissa & 0x1FFF;
+        if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+            half++;
+        }
+        return sign | (uint16_t)half;
+    }
+}
+
+// Convert IEEE half precision to float
+inline float halfToFloat(uint16_t half)
+{
+    const uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1F;
+    const uint32_t mantissa = half & 0x3FF;
+
+    float value;
+    if(exponent == 0) {
+        value = std::ldexp((float)mantissa, -24);
+    }
+    else if(exponent == 31) {
+        value = mantissa ? NAN : INFINITY;
+    }
+    else {
+        value = std::ldexp((float)(mantissa | 0x400), (int)exponent - 25);
+    }
+    return sign ? -value : value;
+}
+
+#ifdef SIMD_X86
+// Dot product of half precision weights with 8-bit pixels from i, 8 at a time using AVX2, F16C and FMA,
+// advancing i past the weights processed
+SIMD_TARGET("avx2,f16c,fma") inline float dotHalfAVX2(const uint16_t *weights, const uint8_t *pixels, size_t n, size_t &i)
+{
+    __m256 dot256 = _mm256_setzero_ps();
+    for(; (i + 8) <= n; i += 8) {
+        const __m256 w = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i)));
+        const __m256 p = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixels + i))));
+        dot256 = _mm256_fmadd_ps(w, p, dot256);
+    }
+
+    // Sum lanes
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, dot256);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+// Exact dot product of 8-bit signed weights with 8-bit pixels from i, 16 at a time using AVX2, advancing i past the
+// weights processed
+SIMD_TARGET("avx2") inline int32_t dotInt8AVX2(const int8_t *weights, const uint8_t *pixels, size_t n, size_t &i)
+{
+    __m256i dot256 = _mm256_setzero_si256();
+    for(; (i + 16) <= n; i += 16) {
+        const __m256i w = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i)));
+        const __m256i p = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i)));
+        dot256 = _mm256_add_epi32(dot256, _mm256_madd_epi16(w, p));
+    }
+
+    // Sum 32-bit lanes
+    alignas(32) int32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), dot256);
+    int32_t dot = 0;
+    for(int l = 0; l < 8; l++) {
+        dot += lanes[l];
+    }
+    return dot;
+}
+#endif
+
+// Dot product of half precision weights with 8-bit pixels. Uses AVX2, F16C and FMA instructions where the CPU supports them
+inline float dotHalf(const uint16_t *weights, const uint8_t *pixels, size_t n)
+{
+    size_t i = 0;
+    float dot = 0.0f;
+
+#ifdef SIMD_X86
+    // Process 8 weights at a time
+    if(hasAVX2F16CFMA()) {
+        dot += dotHalfAVX2(weights, pixels, n, i);
+    }
+#endif
+
+    // Process remaining weights
+    for(; i < n; i++) {
+        dot += halfToFloat(weights[i]) * (float)pixels[i];
+    }
+    return dot;
+}
+
+// Exact dot product of 8-bit signed weights with 8-bit pixels. Uses AVX2 pmaddwd instructions (which multiply
+// 16-bit values and sum adjacent pairs into 32-bit lanes) where the CPU supports them. **NOTE** pmaddubsw is not used
+// as its 16-bit pair sums can saturate with full-range pixels
+inline int32_t dotInt8(const int8_t *weights, const uint8_t *pixels, size_t n)
+{
+    size_t i = 0;
+    int32_t dot = 0;
+
+#ifdef SIMD_X86
+    // Process 16 weights at a time
+    if(hasAVX2()) {
+        dot += dotInt8AVX2(weights, pixels, n, i);
+    }
+#endif
+
+    // Process remaining weights
+    for(; i < n; i++) {
+        dot += (int32_t)weights[i] * (int32_t)pixels[i];
+    }
+    return dot;
+}
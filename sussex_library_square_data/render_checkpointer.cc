@@ -0,0 +1,81 @@
+#include "render_checkpointer.h"
+
+//------------------------------------------------------------------------
+// RenderCheckpointer
+//------------------------------------------------------------------------
+RenderCheckpointer::RenderCheckpointer(const std::string &filename, size_t pointInterval, double secondsInterval)
+:   m_Filename(filename), m_PointInterval(pointInterval), m_TimeInterval(secondsInterval),
+    m_NumPointsSinceSnapshot(0), m_LastSnapshotTime(std::chrono::steady_clock::now()),
+    m_HasPendingImage(false), m_Quit(false), m_WriterThread(&RenderCheckpointer::writerThread, this)
+{
+}
+//------------------------------------------------------------------------
+RenderCheckpointer::~RenderCheckpointer()
+{
+    stopWriterThread();
+}
+//------------------------------------------------------------------------
+void RenderCheckpointer::update(const cv::Mat &image)
+{
+    m_NumPointsSinceSnapshot++;
+
+    // If neither trigger has fired, return
+    const auto now = std::chrono::steady_clock::now();
+    const bool pointTrigger = (m_PointInterval > 0 && m_NumPointsSinceSnapshot >= m_PointInterval);
+    const bool timeTrigger = (m_TimeInterval.count() > 0.0 && (now - m_LastSnapshotTime) >= m_TimeInterval);
+    if(!pointTrigger && !timeTrigger) {
+        return;
+    }
+
+    m_NumPointsSinceSnapshot = 0;
+    m_LastSnapshotTime = now;
+
+    // Copy image outside of lock so writer thread is only ever held up by a swap
+    cv::Mat snapshot = image.clone();
+    {
+        std::lock_guard<std::mutex> lock(m_PendingMutex);
+        cv::swap(m_PendingImage, snapshot);
+        m_HasPendingImage = true;
+    }
+    m_PendingCondition.notify_one();
+}
+//------------------------------------------------------------------------
+void RenderCheckpointer::finish(const cv::Mat &image)
+{
+    // Stop writer thread, discarding any snapshot it hasn't got to, and write final image
+    stopWriterThread();
+    cv::imwrite(m_Filename, image);
+}
+//------------------------------------------------------------------------
+void RenderCheckpointer::stopWriterThread()
+{
+    if(m_WriterThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_PendingMutex);
+            m_Quit = true;
+        }
+        m_PendingCondition.notify_one();
+        m_WriterThread.join();
+    }
+}
+//------------------------------------------------------------------------
+void RenderCheckpointer::writerThread()
+{
+    cv::Mat image;
+    while(true) {
+        // Wait for a snapshot or for quit signal
+        {
+            std::unique_lock<std::mutex> lock(m_PendingMutex);
+            m_PendingCondition.wait(lock, [this](){ return m_HasPendingImage || m_Quit; });
+            if(m_Quit) {
+                return;
+            }
+
+            cv::swap(image, m_PendingImage);
+            m_HasPendingImage = false;
+        }
+
+        // Encode and write snapshot without holding lock
+        cv::imwrite(m_Filename, image);
+    }
+}
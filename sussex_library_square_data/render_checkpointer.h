@@ -0,0 +1,60 @@
+#pragma once
+
+// Standard C++ includes
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+//------------------------------------------------------------------------
+// RenderCheckpointer
+//------------------------------------------------------------------------
+// Periodically writes snapshots of an image which is being rendered to disk on a background thread.
+// If the writer thread is still busy when a new snapshot is taken, the older pending snapshot is dropped
+class RenderCheckpointer
+{
+public:
+    // A pointInterval or secondsInterval of zero disables that trigger
+    RenderCheckpointer(const std::string &filename, size_t pointInterval, double secondsInterval);
+    ~RenderCheckpointer();
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    // Call after each point is rendered - snapshots image if enough points or time has passed
+    void update(const cv::Mat &image);
+
+    // Stop background thread and write final image
+    void finish(const cv::Mat &image);
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    void stopWriterThread();
+    void writerThread();
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const std::string m_Filename;
+    const size_t m_PointInterval;
+    const std::chrono::duration<double> m_TimeInterval;
+
+    // Number of points rendered and time of last snapshot
+    size_t m_NumPointsSinceSnapshot;
+    std::chrono::steady_clock::time_point m_LastSnapshotTime;
+
+    // Snapshot waiting to be written, protected by m_PendingMutex
+    std::mutex m_PendingMutex;
+    std::condition_variable m_PendingCondition;
+    cv::Mat m_PendingImage;
+    bool m_HasPendingImage;
+    bool m_Quit;
+
+    std::thread m_WriterThread;
+};
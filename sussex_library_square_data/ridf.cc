@@ -1,3 +1,7 @@
+// Standard C++ includes
+#include <chrono>
+#include <fstream>
+
 // OpenCV
 #include <opencv2/opencv.hpp>
 
@@ -11,6 +15,10 @@
 #include "CLI11.hpp"
 
 #include "memory.h"
+#include "memory_factory.h"
+#include "profiler.h"
+#include "snapshot_cache.h"
+#include "worker_pool.h"
 
 using namespace BoBRobotics;
 using namespace units::literals;
@@ -19,6 +27,53 @@ using namespace units::angle;
 using namespace units::math;
 using namespace units::solid_angle;
 
+//------------------------------------------------------------------------
+// Anonymous namespace
+//------------------------------------------------------------------------
+namespace
+{
+// Write RIDF to CSV, prefixing each line with prefix
+void writeRIDFCSV(std::ostream &os, const std::string &prefix, const std::vector<float> &ridf)
+{
+    const int width = (int)ridf.size();
+    for(size_t c = 0; c < ridf.size(); c++) {
+        // Convert column into pixel rotation
+        int pixelRotation = c;
+        if(pixelRotation > (width / 2)) {
+            pixelRotation -= width;
+        }
+
+        // Convert this into angle and write to output CSV
+        const degree_t heading = turn_t((double)pixelRotation / (double)width);
+        os << prefix << c << ", " << heading << ", " << ridf[c] << std::endl;
+    }
+}
+
+// Plot RIDF as a line graph
+cv::Mat renderRIDF(const std::vector<float> &ridf)
+{
+    // Find maximum RIDF value
+    const float maxRIDF = *std::max_element(ridf.cbegin(), ridf.cend());
+
+    // Make an image to hold RIDF
+    cv::Mat ridfImage(100, (int)ridf.size() * 10,
+                      CV_8UC3, cv::Scalar::all(0));
+
+    // Loop through RIDF columns, except the last
+    for(size_t c = 0; c < (ridf.size() - 1); c++) {
+        // Get familiarity of this and next column
+        const int familiarityPixels = 100 - (int)std::round(100.0 * (ridf[c] / maxRIDF));
+        const int nextFamiliarityPixels = 100 - (int)std::round(100.0 * (ridf[c + 1] / maxRIDF));
+
+        // Draw a line
+        cv::line(ridfImage, cv::Point((int)(c * 10), familiarityPixels),
+                cv::Point((int)((c + 1) * 10), nextFamiliarityPixels),
+                CV_RGB(255, 255, 255));
+    }
+    return ridfImage;
+}
+}   // Anonymous namespace
+
 int main(int argc, char **argv)
 {
     // Default command line arguments
@@ -26,52 +81,61 @@ int main(int argc, char **argv)
     std::string routeName = "route5";
     std::string variantName = "skymask";
     std::string outputImageName = "ridf_image.png";
+    std::string outputImageDirectory = "";
     std::string outputCSVName = "";
     std::string memoryType = "PerfectMemory";
+    MemoryParameters memoryParameters;
     std::string testImagePath;
-    double fovDegrees = 90.0;
+    std::string testListPath;
+    std::string testDatabasePath;
+    unsigned int numThreads = 1;
+    bool profile = false;
+    std::string profileOutputName = "profile.json";
+
+    // Memories aren't rendered
+    memoryParameters.renderGoodMatches = false;
+    memoryParameters.renderBadMatches = false;
 
     // Configure command line parser
     CLI::App app{"BoB robotics R.I.D.F. renderer"};
-    app.add_option("--test-image", testImagePath, "Path to image to test", false);
+    auto testImageOption = app.add_option("--test-image", testImagePath, "Path to image to test", false);
+    auto testListOption = app.add_option("--test-list", testListPath,
+                                         "Path to text file listing images to test, one per line", false);
+    auto testDatabaseOption = app.add_option("--test-database", testDatabasePath,
+                                             "Path to image database whose images should all be tested", false);
+    testImageOption->excludes(testListOption)->excludes(testDatabaseOption);
+    testListOption->excludes(testImageOption)->excludes(testDatabaseOption);
+    testDatabaseOption->excludes(testImageOption)->excludes(testListOption);
     app.add_option("--route", routeName, "Name of route", true);
     app.add_option("--variant", variantName, "Variant of route and grid to use", true);
     app.add_option("--width", imSize.width, "Width of unwrapped image", true);
     app.add_option("--height", imSize.height, "Height of unwrapped image", true);
-    app.add_option("--output-image", outputImageName, "Name of output image to generate", true);
+    app.add_option("--output-image", outputImageName, "Name of output image to generate when testing a single image", true);
+    app.add_option("--output-image-directory", outputImageDirectory,
+                   "When testing a list or database, directory to write an image of each RIDF to (empty to disable)", true);
     app.add_option("--output-csv", outputCSVName, "Name of output CSV to generate", true);
-    app.add_option("--fov", fovDegrees,
-                   "For 'constrained' memories, what angle (in degrees) on either side of route should snapshots be matched in", true);
-    app.add_set("--memory-type", memoryType, {"PerfectMemory", "PerfectMemoryConstrained", "InfoMax", "InfoMaxConstrained"},
+    app.add_option("--threads", numThreads, "Number of threads to train InfoMax weights and calculate RIDFs with", true);
+    app.add_set("--memory-type", memoryType, {"PerfectMemory", "PerfectMemoryConstrained", "PerfectMemoryANN", "PerfectMemorySequence", "InfoMax", "InfoMaxConstrained"},
                 "Type of memory to use for navigation", true);
+    addMemoryOptions(app, memoryParameters);
+    app.add_flag("--profile", profile, "Time each stage and write a summary to the profile output when finished");
+    app.add_option("--profile-output", profileOutputName, "Name of JSON file to write profile summary to", true);
 
     // Parse command line arguments
     CLI11_PARSE(app, argc, argv);
 
+    Profiler::setEnabled(profile);
+    const auto startTime = std::chrono::steady_clock::now();
+
     // Create database from route
     const filesystem::path routePath = filesystem::path("routes") / routeName / variantName;
     std::cout << routePath << std::endl;
+    Profiler::ScopedTimer routeLoadingTimer("Route loading");
     Navigation::ImageDatabase route(routePath);
+    routeLoadingTimer.stop();
 
-    std::unique_ptr<MemoryBase> memory;
-    if(memoryType == "PerfectMemory") {
-        memory.reset(new PerfectMemory(imSize, route,
-                                       false, false));
-    }
-    else if(memoryType == "PerfectMemoryConstrained") {
-        memory.reset(new PerfectMemoryConstrained(imSize, route, degree_t(fovDegrees),
-                                                  false, false));
-    }
-    else if(memoryType == "InfoMax") {
-        memory.reset(new InfoMax(imSize, route));
-    }
-    else if(memoryType == "InfoMaxConstrained") {
-        memory.reset(new InfoMaxConstrained(imSize, route, degree_t(fovDegrees)));
-    }
-    else {
-        throw std::runtime_error("Memory type '" + memoryType + "' not supported");
-    }
-
+    BOB_ASSERT(numThreads > 0);
+    memoryParameters.infoMaxTraining.numThreads = numThreads;
 
     // If a filename is specified, open CSV file other write to std::cout
     std::ofstream outputCSVFile;
@@ -79,50 +143,139 @@ int main(int argc, char **argv)
         outputCSVFile.open(outputCSVName);
     }
     std::ostream &outputCSV = outputCSVName.empty() ? std::cout : outputCSVFile;
-    outputCSV << "Rotation[pixels], Rotation [degrees], familiarity" << std::endl;
 
-    // Load test image and resize
-    cv::Mat testImage = cv::imread(testImagePath, cv::IMREAD_GRAYSCALE);
-    cv::resize(testImage, testImage, imSize);
+    // Number of test images which couldn't be read
+    size_t numFailedImages = 0;
 
-    // Calculate RIDF from test image
-    const auto ridf = memory->calculateRIDF(testImage);
-    BOB_ASSERT(ridf.size() == (size_t)imSize.width);
+    // If a single image is being tested
+    if(testListPath.empty() && testDatabasePath.empty()) {
+        const auto memory = createMemory(memoryType, imSize, route, memoryParameters);
 
-    // Find minimum and maximum RIDF value
-    const float maxRIDF = *std::max_element(ridf.cbegin(), ridf.cend());
+        outputCSV << "Rotation[pixels], Rotation [degrees], familiarity" << std::endl;
 
-    // Make an image to hold RIDF
-    cv::Mat ridfImage(100, imSize.width * 10,
-                      CV_8UC3, cv::Scalar::all(0));
+        // Load test image and resize
+        Profiler::ScopedTimer testImageLoadingTimer("Test image loading");
+        cv::Mat testImage = cv::imread(testImagePath, cv::IMREAD_GRAYSCALE);
+        if(testImage.empty()) {
+            throw std::runtime_error("Could not read test image '" + testImagePath + "'");
+        }
+        cv::resize(testImage, testImage, imSize);
+        testImageLoadingTimer.stop();
 
-    // Loop through RIDF columns
-    for(size_t c = 0; c < ridf.size(); c++) {
-        // Convert column into pixel rotation
-        int pixelRotation = c;
-        if(pixelRotation > (imSize.width / 2)) {
-            pixelRotation -= imSize.width;
+        // Calculate RIDF from test image
+        Profiler::ScopedTimer ridfTimer("RIDF calculation");
+        const auto ridf = memory->calculateRIDF(testImage);
+        BOB_ASSERT(ridf.size() == (size_t)imSize.width);
+        ridfTimer.stop();
+
+        // Write RIDF to CSV and image
+        {
+            Profiler::ScopedTimer timer("CSV writing");
+            writeRIDFCSV(outputCSV, "", ridf);
+        }
+        {
+            Profiler::ScopedTimer timer("RIDF plotting");
+            cv::imwrite(outputImageName, renderRIDF(ridf));
         }
+    }
+    // Otherwise, test every image in list or database
+    else {
+        // Read names of test images from list
+        std::vector<std::string> testImageNames;
+        std::unique_ptr<Navigation::ImageDatabase> testDatabase;
+        std::unique_ptr<SnapshotCache> testSnapshots;
+        if(!testListPath.empty()) {
+            std::ifstream testList(testListPath);
+            if(!testList.good()) {
+                throw std::runtime_error("Could not open test list '" + testListPath + "'");
+            }
+            std::string line;
+            while(std::getline(testList, line)) {
+                if(!line.empty()) {
+                    testImageNames.push_back(line);
+                }
+            }
+        }
+        // Or get resized images from database, building cache in parallel if necessary
+        else {
+            Profiler::ScopedTimer timer("Test database loading");
+            testDatabase.reset(new Navigation::ImageDatabase(filesystem::path(testDatabasePath)));
+            testSnapshots.reset(new SnapshotCache(*testDatabase, imSize, numThreads));
+            for(const auto &e : *testDatabase) {
+                testImageNames.push_back(e.path.str());
+            }
+        }
+        std::cout << "Calculating RIDFs of " << testImageNames.size() << " images" << std::endl;
 
-        // Convert this into angle and write to output CSV
-        const degree_t heading = turn_t((double)pixelRotation / (double)imSize.width);
-        outputCSV << c << ", " << heading << ", " << ridf[c] << std::endl;
-
-        // If this isn't the last column
-        if(c < (ridf.size() - 1)) {
-            // Get familiarity of this and next column
-            const int familiarityPixels = 100 - (int)std::round(100.0 * (ridf[c] / maxRIDF));
-            const int nextFamiliarityPixels = 100 - (int)std::round(100.0 * (ridf[c + 1] / maxRIDF));
-
-            // Draw a line
-            cv::line(ridfImage, cv::Point((int)(c * 10), familiarityPixels),
-                    cv::Point((int)((c + 1) * 10), nextFamiliarityPixels),
-                    CV_RGB(255, 255, 255));
+        // Create memory, giving each thread its own copy as the underlying navigation algorithms use scratch buffers
+        const auto memory = createMemory(memoryType, imSize, route, memoryParameters);
+        std::vector<std::unique_ptr<MemoryBase>> memories;
+        for(unsigned int t = 0; t < numThreads; t++) {
+            memories.push_back(memory->clone());
+        }
+
+        outputCSV << "Image index, Image path, Rotation[pixels], Rotation [degrees], familiarity" << std::endl;
+
+        // Calculate RIDFs in parallel, writing them to CSV strictly in image order so it is identical to a serial run
+        std::vector<cv::Mat> testImages(numThreads);
+        std::vector<std::vector<float>> ridfs(numThreads);
+        runOrdered(numThreads, testImageNames.size(),
+                   [&](size_t i, unsigned int t)
+                   {
+                       // Get resized image from cache or load and resize it
+                       Profiler::ScopedTimer testImageLoadingTimer("Test image loading");
+                       cv::Mat &testImage = testImages[t];
+                       if(testSnapshots) {
+                           testImage = (*testSnapshots)[i];
+                       }
+                       else {
+                           testImage = cv::imread(testImageNames[i], cv::IMREAD_GRAYSCALE);
+                           if(!testImage.empty()) {
+                               cv::resize(testImage, testImage, imSize);
+                           }
+                       }
+                       testImageLoadingTimer.stop();
+
+                       // Calculate RIDF and, if required, plot it
+                       if(!testImage.empty()) {
+                           {
+                               Profiler::ScopedTimer timer("RIDF calculation");
+                               ridfs[t] = memories[t]->calculateRIDF(testImage);
+                           }
+                           BOB_ASSERT(ridfs[t].size() == (size_t)imSize.width);
+
+                           if(!outputImageDirectory.empty()) {
+                               Profiler::ScopedTimer timer("RIDF plotting");
+                               cv::imwrite((filesystem::path(outputImageDirectory) / ("ridf_" + std::to_string(i) + ".png")).str(),
+                                           renderRIDF(ridfs[t]));
+                           }
+                       }
+                   },
+                   [&](size_t i, unsigned int t)
+                   {
+                       if(testImages[t].empty()) {
+                           std::cerr << "Could not read test image '" << testImageNames[i] << "' - skipping" << std::endl;
+                           numFailedImages++;
+                       }
+                       else {
+                           Profiler::ScopedTimer timer("CSV writing");
+                           writeRIDFCSV(outputCSV, std::to_string(i) + ", " + testImageNames[i] + ", ", ridfs[t]);
+                       }
+                   });
+
+        if(numFailedImages > 0) {
+            std::cerr << numFailedImages << " test images could not be read" << std::endl;
         }
     }
 
-    // Save RIDF image
-    cv::imwrite(outputImageName, ridfImage);
+    // Write profile summary
+    if(profile) {
+        const std::chrono::duration<double> totalTime = std::chrono::steady_clock::now() - startTime;
+        Profiler::addDuration("Total", totalTime.count());
+
+        std::ofstream profileOutput(profileOutputName);
+        Profiler::writeJSON(profileOutput);
+    }
 
-    return EXIT_SUCCESS;
+    return (numFailedImages > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -0,0 +1,633 @@
+#include "ridf_engine.h"
+
+// Standard C++ includes
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+// BoB robotics includes
+#include "common/assert.h"
+
+#include "sad.h"
+
+//------------------------------------------------------------------------
+// RIDFEngine
+//------------------------------------------------------------------------
+RIDFEngine::RIDFEngine(const cv::Size &imSize)
+:   m_ImageSize(imSize)
+{
+}
+//------------------------------------------------------------------------
+RIDFEngine::~RIDFEngine()
+{
+}
+//------------------------------------------------------------------------
+void RIDFEngine::calculateColumnMinima(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                       std::vector<float> &lowestDifferences, std::vector<size_t> &bestSnapshots) const
+{
+    // Get 'matrix' of differences
+    const auto &allDifferences = getImageDifferences(image);
+
+    lowestDifferences.assign(getImageSize().width, std::numeric_limits<float>::max());
+    bestSnapshots.assign(getImageSize().width, std::numeric_limits<size_t>::max());
+
+    // Loop through all snapshots, keeping track of lowest difference in each column
+    // **NOTE** strict comparison means the lowest snapshot index wins ties
+    for(size_t s = 0; s < allDifferences.size(); s++) {
+        const auto &snapshotDifferences = allDifferences[s];
+        for(const auto &r : columnRanges) {
+            for(int c = r.first; c < r.second; c++) {
+                if(snapshotDifferences[c] < lowestDifferences[c]) {
+                    lowestDifferences[c] = snapshotDifferences[c];
+                    bestSnapshots[c] = s;
+                }
+            }
+        }
+    }
+}
+//------------------------------------------------------------------------
+std::tuple<size_t, int, float> RIDFEngine::findBestMatch(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges) const
+{
+    // Get lowest difference at each rotation
+    std::vector<float> lowestDifferences;
+    std::vector<size_t> bestSnapshots;
+    calculateColumnMinima(image, columnRanges, lowestDifferences, bestSnapshots);
+
+    // Find best rotation, breaking ties on lowest snapshot index and then lowest rotation
+    size_t bestSnapshot = std::numeric_limits<size_t>::max();
+    int bestColumn = -1;
+    float lowestDifference = std::numeric_limits<float>::max();
+    for(const auto &r : columnRanges) {
+        for(int c = r.first; c < r.second; c++) {
+            if(lowestDifferences[c] < lowestDifference
+                || (lowestDifferences[c] == lowestDifference && bestSnapshots[c] < bestSnapshot)
+                || (lowestDifferences[c] == lowestDifference && bestSnapshots[c] == bestSnapshot && c < bestColumn))
+            {
+                bestSnapshot = bestSnapshots[c];
+                bestColumn = c;
+                lowestDifference = lowestDifferences[c];
+            }
+        }
+    }
+    return std::make_tuple(bestSnapshot, bestColumn, lowestDifference);
+}
+//------------------------------------------------------------------------
+std::tuple<size_t, int, float> RIDFEngine::findBestMatch(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                                         const std::vector<size_t> &snapshots) const
+{
+    // Get 'matrix' of differences with listed snapshots only
+    const auto &differences = getImageDifferences(image, snapshots);
+
+    // Loop through listed snapshots, breaking ties on lowest snapshot index and then lowest rotation
+    size_t bestSnapshot = std::numeric_limits<size_t>::max();
+    int bestColumn = -1;
+    float lowestDifference = std::numeric_limits<float>::max();
+    for(size_t i = 0; i < snapshots.size(); i++) {
+        const size_t s = snapshots[i];
+        for(const auto &r : columnRanges) {
+            for(int c = r.first; c < r.second; c++) {
+                const float difference = differences[i][c];
+                if(difference < lowestDifference
+                    || (difference == lowestDifference && std::tie(s, c) < std::tie(bestSnapshot, bestColumn)))
+                {
+                    bestSnapshot = s;
+                    bestColumn = c;
+                    lowestDifference = difference;
+                }
+            }
+        }
+    }
+    return std::make_tuple(bestSnapshot, bestColumn, lowestDifference);
+}
+//------------------------------------------------------------------------
+const std::vector<std::vector<float>> &RIDFEngine::getImageDifferences(const cv::Mat &image) const
+{
+    m_ScratchAllSnapshots.resize(getNumSnapshots());
+    std::iota(m_ScratchAllSnapshots.begin(), m_ScratchAllSnapshots.end(), 0);
+    return getImageDifferences(image, m_ScratchAllSnapshots);
+}
+//------------------------------------------------------------------------
+void RIDFEngine::calculateColumnMinima(const cv::Mat &image, std::vector<float> &lowestDifferences,
+                                       std::vector<size_t> &bestSnapshots) const
+{
+    calculateColumnMinima(image, {ColumnRange(0, getImageSize().width)}, lowestDifferences, bestSnapshots);
+}
+
+//------------------------------------------------------------------------
+// RIDFEngineDirect
+//------------------------------------------------------------------------
+RIDFEngineDirect::RIDFEngineDirect(const cv::Size &imSize)
+:   RIDFEngine(imSize), m_Snapshots(std::make_shared<std::vector<cv::Mat>>())
+{
+}
+//------------------------------------------------------------------------
+void RIDFEngineDirect::train(const cv::Mat &snapshot)
+{
+    BOB_ASSERT(m_Snapshots.use_count() == 1);
+    BOB_ASSERT(snapshot.type() == CV_8UC1);
+    BOB_ASSERT(snapshot.size() == getImageSize());
+
+    m_Snapshots->push_back(snapshot.clone());
+}
+//------------------------------------------------------------------------
+std::unique_ptr<RIDFEngine> RIDFEngineDirect::clone() const
+{
+    return std::unique_ptr<RIDFEngine>(new RIDFEngineDirect(*this));
+}
+//------------------------------------------------------------------------
+const std::vector<std::vector<float>> &RIDFEngineDirect::getImageDifferences(const cv::Mat &image, const std::vector<size_t> &snapshots) const
+{
+    BOB_ASSERT(image.type() == CV_8UC1);
+    BOB_ASSERT(image.size() == getImageSize());
+
+    m_Differences.resize(snapshots.size());
+    for(auto &d : m_Differences) {
+        d.resize(getImageSize().width);
+    }
+
+    // Roll image to each rotation and calculate mean absolute difference with each listed snapshot
+    for(int c = 0; c < getImageSize().width; c++) {
+        rollImage(image, m_ScratchRolledImage, c);
+        for(size_t i = 0; i < snapshots.size(); i++) {
+            cv::absdiff(m_ScratchRolledImage, (*m_Snapshots)[snapshots[i]], m_ScratchDifferenceImage);
+            m_Differences[i][c] = (float)cv::mean(m_ScratchDifferenceImage)[0];
+        }
+    }
+    return m_Differences;
+}
+
+//------------------------------------------------------------------------
+// RIDFEngineFused
+//------------------------------------------------------------------------
+RIDFEngineFused::RIDFEngineFused(const cv::Size &imSize)
+:   RIDFEngine(imSize), m_TileSize(std::max<size_t>(1, (256 * 1024) / imSize.area())), m_NumSnapshots(0),
+    m_Snapshots(std::make_shared<std::vector<uint8_t>>())
+{
+}
+//------------------------------------------------------------------------
+void RIDFEngineFused::train(const cv::Mat &snapshot)
+{
+    BOB_ASSERT(m_Snapshots.use_count() == 1);
+    BOB_ASSERT(snapshot.type() == CV_8UC1);
+    BOB_ASSERT(snapshot.size() == getImageSize());
+
+    // Append rows of snapshot to contiguous storage
+    for(int y = 0; y < snapshot.rows; y++) {
+        const uint8_t *row = snapshot.ptr<uint8_t>(y);
+        m_Snapshots->insert(m_Snapshots->end(), row, row + snapshot.cols);
+    }
+    m_NumSnapshots++;
+}
+//------------------------------------------------------------------------
+std::unique_ptr<RIDFEngine> RIDFEngineFused::clone() const
+{
+    return std::unique_ptr<RIDFEngine>(new RIDFEngineFused(*this));
+}
+//------------------------------------------------------------------------
+const std::vector<std::vector<float>> &RIDFEngineFused::getImageDifferences(const cv::Mat &image, const std::vector<size_t> &snapshots) const
+{
+    buildDoubledImage(image);
+
+    m_Differences.resize(snapshots.size());
+    for(size_t i = 0; i < snapshots.size(); i++) {
+        m_Differences[i].resize(getImageSize().width);
+        for(int c = 0; c < getImageSize().width; c++) {
+            m_Differences[i][c] = getMeanDifference(calculateSAD(snapshots[i], c));
+        }
+    }
+    return m_Differences;
+}
+//------------------------------------------------------------------------
+void RIDFEngineFused::calculateColumnMinima(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                            std::vector<float> &lowestDifferences, std::vector<size_t> &bestSnapshots) const
+{
+    buildDoubledImage(image);
+
+    // Keep running minimum sum of absolute differences in each column
+    // **NOTE** sums are exact so comparing them is equivalent to comparing mean differences
+    std::vector<uint32_t> lowestSADs(getImageSize().width, std::numeric_limits<uint32_t>::max());
+    bestSnapshots.assign(getImageSize().width, std::numeric_limits<size_t>::max());
+
+    // Loop through tiles of snapshots
+    for(size_t tileStart = 0; tileStart < getNumSnapshots(); tileStart += m_TileSize) {
+        const size_t tileEnd = std::min(getNumSnapshots(), tileStart + m_TileSize);
+
+        // Stream every requested rotation over the snapshots in the tile
+        // **NOTE** snapshots are visited in order so strict comparison means the lowest snapshot index wins ties
+        for(const auto &r : columnRanges) {
+            for(int c = r.first; c < r.second; c++) {
+                for(size_t s = tileStart; s < tileEnd; s++) {
+                    const uint32_t sad = calculateSAD(s, c);
+                    if(sad < lowestSADs[c]) {
+                        lowestSADs[c] = sad;
+                        bestSnapshots[c] = s;
+                    }
+                }
+            }
+        }
+    }
+
+    // Convert sums into means
+    lowestDifferences.resize(getImageSize().width);
+    std::transform(lowestSADs.cbegin(), lowestSADs.cend(), lowestDifferences.begin(),
+                   [this](uint32_t sad)
+                   {
+                       return (sad == std::numeric_limits<uint32_t>::max()) ? std::numeric_limits<float>::max() : getMeanDifference(sad);
+                   });
+}
+//------------------------------------------------------------------------
+std::tuple<size_t, int, float> RIDFEngineFused::findBestMatch(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                                              const std::vector<size_t> &snapshots) const
+{
+    buildDoubledImage(image);
+
+    // Loop through listed snapshots, abandoning sums which exceed the best so far
+    uint32_t lowestSAD = std::numeric_limits<uint32_t>::max();
+    size_t bestSnapshot = std::numeric_limits<size_t>::max();
+    int bestColumn = -1;
+    for(size_t s : snapshots) {
+        for(const auto &r : columnRanges) {
+            for(int c = r.first; c < r.second; c++) {
+                const uint32_t sad = calculateSAD(s, c, lowestSAD);
+                if(sad < lowestSAD || (sad == lowestSAD && std::tie(s, c) < std::tie(bestSnapshot, bestColumn))) {
+                    lowestSAD = sad;
+                    bestSnapshot = s;
+                    bestColumn = c;
+                }
+            }
+        }
+    }
+
+    // If no snapshots were listed, return same as base class
+    const float lowestDifference = (bestSnapshot == std::numeric_limits<size_t>::max()) ? std::numeric_limits<float>::max() : getMeanDifference(lowestSAD);
+    return std::make_tuple(bestSnapshot, bestColumn, lowestDifference);
+}
+//------------------------------------------------------------------------
+void RIDFEngineFused::buildDoubledImage(const cv::Mat &image) const
+{
+    BOB_ASSERT(image.type() == CV_8UC1);
+    BOB_ASSERT(image.size() == getImageSize());
+
+    const int width = getImageSize().width;
+    m_ScratchDoubledImage.resize(2 * getImageSize().area());
+    for(int y = 0; y < image.rows; y++) {
+        const uint8_t *row = image.ptr<uint8_t>(y);
+        uint8_t *doubledRow = &m_ScratchDoubledImage[2 * width * y];
+        std::copy_n(row, width, doubledRow);
+        std::copy_n(row, width, doubledRow + width);
+    }
+}
+//------------------------------------------------------------------------
+uint32_t RIDFEngineFused::calculateSAD(size_t snapshot, int rotation, uint32_t abandonThreshold) const
+{
+    const int width = getImageSize().width;
+    const uint8_t *snapshotRow = getSnapshot(snapshot);
+    const uint8_t *imageRow = &m_ScratchDoubledImage[rotation];
+
+    uint32_t sad = 0;
+    for(int y = 0; y < getImageSize().height; y++) {
+        sad += sumAbsoluteDifferences(snapshotRow, imageRow, width);
+        if(sad > abandonThreshold) {
+            break;
+        }
+        snapshotRow += width;
+        imageRow += 2 * width;
+    }
+    return sad;
+}
+
+//------------------------------------------------------------------------
+// RIDFEngineEarlyAbandon
+//------------------------------------------------------------------------
+RIDFEngineEarlyAbandon::RIDFEngineEarlyAbandon(const cv::Size &imSize, size_t seedWindow)
+:   RIDFEngineFused(imSize), m_SeedWindow(seedWindow), m_SnapshotColumnSums(std::make_shared<std::vector<uint32_t>>()),
+    m_PreviousBestSnapshot(0)
+{
+}
+//------------------------------------------------------------------------
+void RIDFEngineEarlyAbandon::train(const cv::Mat &snapshot)
+{
+    // Superclass
+    RIDFEngineFused::train(snapshot);
+
+    // Calculate column sums of new snapshot and append
+    calculateColumnSums(getSnapshot(getNumSnapshots() - 1), m_ScratchColumnSums);
+    m_SnapshotColumnSums->insert(m_SnapshotColumnSums->end(), m_ScratchColumnSums.cbegin(), m_ScratchColumnSums.cend());
+}
+//------------------------------------------------------------------------
+std::unique_ptr<RIDFEngine> RIDFEngineEarlyAbandon::clone() const
+{
+    return std::unique_ptr<RIDFEngine>(new RIDFEngineEarlyAbandon(*this));
+}
+//------------------------------------------------------------------------
+std::tuple<size_t, int, float> RIDFEngineEarlyAbandon::findBestMatch(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges) const
+{
+    BOB_ASSERT(getNumSnapshots() > 0);
+    BOB_ASSERT(!columnRanges.empty());
+    buildDoubledImage(image);
+
+    const int width = getImageSize().width;
+
+    // Best match, ordered by SAD, then snapshot index, then rotation
+    uint32_t lowestSAD = std::numeric_limits<uint32_t>::max();
+    size_t bestSnapshot = std::numeric_limits<size_t>::max();
+    int bestColumn = -1;
+    auto evaluate =
+        [&](size_t s)
+        {
+            for(const auto &r : columnRanges) {
+                for(int c = r.first; c < r.second; c++) {
+                    // **NOTE** a candidate whose partial sum is only equal to the best may still win a tie
+                    const uint32_t sad = calculateSAD(s, c, lowestSAD);
+                    if(sad < lowestSAD || (sad == lowestSAD && std::tie(s, c) < std::tie(bestSnapshot, bestColumn))) {
+                        lowestSAD = sad;
+                        bestSnapshot = s;
+                        bestColumn = c;
+                    }
+                }
+            }
+        };
+
+    // Seed search with all rotations of snapshots around previous best
+    const size_t seedBegin = (m_PreviousBestSnapshot > m_SeedWindow) ? (m_PreviousBestSnapshot - m_SeedWindow) : 0;
+    const size_t seedEnd = std::min(getNumSnapshots(), m_PreviousBestSnapshot + m_SeedWindow + 1);
+    for(size_t s = seedBegin; s < seedEnd; s++) {
+        evaluate(s);
+    }
+
+    // Calculate column sums of image, doubled so rotations are contiguous
+    calculateColumnSums(image.ptr<uint8_t>(), m_ScratchColumnSums);
+    m_ScratchColumnSums.insert(m_ScratchColumnSums.end(), m_ScratchColumnSums.cbegin(), m_ScratchColumnSums.cend());
+
+    // Calculate lower bound for all other snapshots at any rotation, discarding those which can't beat or tie with the seed
+    m_ScratchCandidates.clear();
+    for(size_t s = 0; s < getNumSnapshots(); s++) {
+        if(s >= seedBegin && s < seedEnd) {
+            continue;
+        }
+
+        const uint32_t *snapshotColumnSums = &(*m_SnapshotColumnSums)[s * width];
+        uint32_t lowestBound = std::numeric_limits<uint32_t>::max();
+        for(const auto &r : columnRanges) {
+            for(int c = r.first; c < r.second; c++) {
+                const uint32_t *imageColumnSums = &m_ScratchColumnSums[c];
+                uint32_t bound = 0;
+                for(int x = 0; x < width; x++) {
+                    bound += (uint32_t)std::abs((int32_t)snapshotColumnSums[x] - (int32_t)imageColumnSums[x]);
+                }
+                lowestBound = std::min(lowestBound, bound);
+            }
+        }
+
+        if(lowestBound <= lowestSAD) {
+            m_ScratchCandidates.emplace_back(lowestBound, s);
+        }
+    }
+
+    // Evaluate snapshots in order of lower bound, popping them from a min-heap, until bound exceeds best
+    // **NOTE** building the heap is linear and only the snapshots which are evaluated are ever ordered
+    std::make_heap(m_ScratchCandidates.begin(), m_ScratchCandidates.end(), std::greater<std::pair<uint32_t, size_t>>());
+    for(auto end = m_ScratchCandidates.end(); end != m_ScratchCandidates.begin(); --end) {
+        const auto &candidate = m_ScratchCandidates.front();
+        if(candidate.first > lowestSAD) {
+            break;
+        }
+        evaluate(candidate.second);
+        std::pop_heap(m_ScratchCandidates.begin(), end, std::greater<std::pair<uint32_t, size_t>>());
+    }
+
+    // Check a rotation was actually evaluated
+    BOB_ASSERT(bestSnapshot != std::numeric_limits<size_t>::max());
+    m_PreviousBestSnapshot = bestSnapshot;
+    return std::make_tuple(bestSnapshot, bestColumn, getMeanDifference(lowestSAD));
+}
+//------------------------------------------------------------------------
+void RIDFEngineEarlyAbandon::calculateColumnSums(const uint8_t *pixels, std::vector<uint32_t> &columnSums) const
+{
+    const int width = getImageSize().width;
+    columnSums.assign(width, 0);
+    for(int y = 0; y < getImageSize().height; y++) {
+        for(int x = 0; x < width; x++) {
+            columnSums[x] += pixels[(y * width) + x];
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+// RIDFEnginePrefilter
+//------------------------------------------------------------------------
+RIDFEnginePrefilter::RIDFEnginePrefilter(const cv::Size &imSize, size_t numCandidates)
+:   RIDFEngineFused(imSize), m_NumCandidates(numCandidates), m_SortedSnapshots(std::make_shared<std::vector<uint8_t>>()),
+    m_ScratchSortedImage(imSize.area())
+{
+}
+//------------------------------------------------------------------------
+void RIDFEnginePrefilter::train(const cv::Mat &snapshot)
+{
+    // Superclass
+    RIDFEngineFused::train(snapshot);
+
+    // Append sorted rows of new snapshot
+    const size_t area = getImageSize().area();
+    m_SortedSnapshots->resize(m_SortedSnapshots->size() + area);
+    sortRows(getSnapshot(getNumSnapshots() - 1), getImageSize(), &(*m_SortedSnapshots)[m_SortedSnapshots->size() - area]);
+}
+//------------------------------------------------------------------------
+std::unique_ptr<RIDFEngine> RIDFEnginePrefilter::clone() const
+{
+    return std::unique_ptr<RIDFEngine>(new RIDFEnginePrefilter(*this));
+}
+//------------------------------------------------------------------------
+std::tuple<size_t, int, float> RIDFEnginePrefilter::findBestMatch(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges) const
+{
+    BOB_ASSERT(getNumSnapshots() > 0);
+    BOB_ASSERT(!columnRanges.empty());
+    buildDoubledImage(image);
+
+    // Calculate lower bound for each snapshot
+    const size_t area = getImageSize().area();
+    sortRows(image.ptr<uint8_t>(), getImageSize(), m_ScratchSortedImage.data());
+    m_ScratchCandidates.resize(getNumSnapshots());
+    for(size_t s = 0; s < getNumSnapshots(); s++) {
+        m_ScratchCandidates[s] = std::make_pair(sumAbsoluteDifferences(&(*m_SortedSnapshots)[s * area], m_ScratchSortedImage.data(), area), s);
+    }
+
+    // Sort snapshots by lower bound, keeping only the best candidates in approximate mode
+    if(m_NumCandidates > 0 && m_NumCandidates < m_ScratchCandidates.size()) {
+        std::partial_sort(m_ScratchCandidates.begin(), m_ScratchCandidates.begin() + m_NumCandidates, m_ScratchCandidates.end());
+        m_ScratchCandidates.resize(m_NumCandidates);
+    }
+    else {
+        std::sort(m_ScratchCandidates.begin(), m_ScratchCandidates.end());
+    }
+
+    // Evaluate candidates in order of lower bound until bound exceeds best
+    uint32_t lowestSAD = std::numeric_limits<uint32_t>::max();
+    size_t bestSnapshot = std::numeric_limits<size_t>::max();
+    int bestColumn = -1;
+    for(const auto &candidate : m_ScratchCandidates) {
+        if(candidate.first > lowestSAD) {
+            break;
+        }
+
+        size_t s = candidate.second;
+        for(const auto &r : columnRanges) {
+            for(int c = r.first; c < r.second; c++) {
+                // If this rotation is a better match than current best or ties with it but has lower snapshot index or rotation
+                const uint32_t sad = calculateSAD(s, c, lowestSAD);
+                if(sad < lowestSAD || (sad == lowestSAD && std::tie(s, c) < std::tie(bestSnapshot, bestColumn))) {
+                    lowestSAD = sad;
+                    bestSnapshot = s;
+                    bestColumn = c;
+                }
+            }
+        }
+    }
+
+    return std::make_tuple(bestSnapshot, bestColumn, getMeanDifference(lowestSAD));
+}
+
+//------------------------------------------------------------------------
+// RIDFEngineFFT
+//------------------------------------------------------------------------
+RIDFEngineFFT::RIDFEngineFFT(const cv::Size &imSize)
+:   RIDFEngine(imSize), m_NumFrequencies((imSize.width / 2) + 1),
+    m_SnapshotSpectra(std::make_shared<std::vector<std::vector<std::complex<float>>>>()),
+    m_SnapshotEnergies(std::make_shared<std::vector<double>>())
+{
+}
+//------------------------------------------------------------------------
+void RIDFEngineFFT::train(const cv::Mat &snapshot)
+{
+    BOB_ASSERT(m_SnapshotSpectra.use_count() == 1);
+
+    m_SnapshotSpectra->emplace_back();
+    m_SnapshotEnergies->push_back(calculateSpectrum(snapshot, m_SnapshotSpectra->back()));
+}
+//------------------------------------------------------------------------
+std::unique_ptr<RIDFEngine> RIDFEngineFFT::clone() const
+{
+    return std::unique_ptr<RIDFEngine>(new RIDFEngineFFT(*this));
+}
+//------------------------------------------------------------------------
+const std::vector<std::vector<float>> &RIDFEngineFFT::getImageDifferences(const cv::Mat &image, const std::vector<size_t> &snapshots) const
+{
+    const int width = getImageSize().width;
+    const int height = getImageSize().height;
+    const double numPixels = (double)(width * height);
+
+    // Calculate image spectrum
+    const double imageEnergy = calculateSpectrum(image, m_ScratchImageSpectrum);
+
+    m_ScratchCrossSpectrum.create(1, width, CV_32FC2);
+    std::complex<float> *crossSpectrum = m_ScratchCrossSpectrum.ptr<std::complex<float>>();
+
+    m_Differences.resize(snapshots.size());
+    for(size_t i = 0; i < snapshots.size(); i++) {
+        const size_t s = snapshots[i];
+        const auto &snapshotSpectrum = (*m_SnapshotSpectra)[s];
+
+        // Sum product of image spectrum and conjugate of snapshot spectrum across rows
+        std::fill_n(crossSpectrum, m_NumFrequencies, std::complex<float>(0.0f, 0.0f));
+        for(int y = 0; y < height; y++) {
+            const std::complex<float> *imageRow = &m_ScratchImageSpectrum[y * m_NumFrequencies];
+            const std::complex<float> *snapshotRow = &snapshotSpectrum[y * m_NumFrequencies];
+            for(int k = 0; k < m_NumFrequencies; k++) {
+                crossSpectrum[k] += imageRow[k] * std::conj(snapshotRow[k]);
+            }
+        }
+
+        // Fill in redundant half of spectrum from conjugate symmetry
+        for(int k = m_NumFrequencies; k < width; k++) {
+            crossSpectrum[k] = std::conj(crossSpectrum[width - k]);
+        }
+
+        // Inverse transform to get cross-correlation at every rotation
+        cv::dft(m_ScratchCrossSpectrum, m_ScratchCrossCorrelation, cv::DFT_INVERSE | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+        const float *crossCorrelation = m_ScratchCrossCorrelation.ptr<float>();
+
+        // Convert to root mean square difference
+        auto &snapshotDifferences = m_Differences[i];
+        snapshotDifferences.resize(width);
+        for(int c = 0; c < width; c++) {
+            const double sumSquareDifference = (*m_SnapshotEnergies)[s] + imageEnergy - (2.0 * crossCorrelation[c]);
+            snapshotDifferences[c] = (float)std::sqrt(std::max(0.0, sumSquareDifference) / numPixels);
+        }
+    }
+
+    return m_Differences;
+}
+//------------------------------------------------------------------------
+double RIDFEngineFFT::calculateSpectrum(const cv::Mat &image, std::vector<std::complex<float>> &spectrum) const
+{
+    BOB_ASSERT(image.type() == CV_8UC1);
+    BOB_ASSERT(image.size() == getImageSize());
+
+    // Convert to float, centred on zero to reduce the magnitude of the terms which cancel when calculating differences
+    image.convertTo(m_ScratchFloatImage, CV_32F, 1.0, -128.0);
+
+    // Calculate image energy
+    double energy = 0.0;
+    for(int y = 0; y < m_ScratchFloatImage.rows; y++) {
+        const float *row = m_ScratchFloatImage.ptr<float>(y);
+        for(int x = 0; x < m_ScratchFloatImage.cols; x++) {
+            energy += (double)row[x] * (double)row[x];
+        }
+    }
+
+    // Calculate spectrum of each row and copy out non-redundant half
+    cv::dft(m_ScratchFloatImage, m_ScratchRowSpectra, cv::DFT_ROWS | cv::DFT_COMPLEX_OUTPUT);
+    spectrum.resize(m_ScratchRowSpectra.rows * m_NumFrequencies);
+    for(int y = 0; y < m_ScratchRowSpectra.rows; y++) {
+        const std::complex<float> *row = m_ScratchRowSpectra.ptr<std::complex<float>>(y);
+        std::copy_n(row, m_NumFrequencies, &spectrum[y * m_NumFrequencies]);
+    }
+    return energy;
+}
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+void rollImage(const cv::Mat &image, cv::Mat &rolledImage, int pixels)
+{
+    BOB_ASSERT(image.type() == CV_8UC1);
+    BOB_ASSERT(pixels >= 0 && pixels < image.cols);
+
+    rolledImage.create(image.size(), CV_8UC1);
+    for(int y = 0; y < image.rows; y++) {
+        const uint8_t *row = image.ptr<uint8_t>(y);
+        std::rotate_copy(row, row + pixels, row + image.cols, rolledImage.ptr<uint8_t>(y));
+    }
+}
+//------------------------------------------------------------------------
+void sortRows(const uint8_t *pixels, const cv::Size &imSize, uint8_t *sortedPixels)
+{
+    std::copy_n(pixels, imSize.area(), sortedPixels);
+    for(int y = 0; y < imSize.height; y++) {
+        std::sort(sortedPixels + (y * imSize.width), sortedPixels + ((y + 1) * imSize.width));
+    }
+}
+//------------------------------------------------------------------------
+std::unique_ptr<RIDFEngine> createRIDFEngine(const std::string &name, const cv::Size &imSize, size_t numCandidates)
+{
+    if(name == "Direct") {
+        return std::unique_ptr<RIDFEngine>(new RIDFEngineDirect(imSize));
+    }
+    else if(name == "Fused") {
+        return std::unique_ptr<RIDFEngine>(new RIDFEngineFused(imSize));
+    }
+    else if(name == "EarlyAbandon") {
+        return std::unique_ptr<RIDFEngine>(new RIDFEngineEarlyAbandon(imSize));
+    }
+    else if(name == "Prefilter") {
+        return std::unique_ptr<RIDFEngine>(new RIDFEnginePrefilter(imSize, numCandidates));
+    }
+    else if(name == "FFT") {
+        return std::unique_ptr<RIDFEngine>(new RIDFEngineFFT(imSize));
+    }
+    else {
+        throw std::runtime_error("RIDF engine '" + name + "' not supported");
+    }
+}
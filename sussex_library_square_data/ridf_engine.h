@@ -0,0 +1,325 @@
+#pragma once
+
+// Standard C++ includes
+#include <complex>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// Half-open range [first, second) of rotations, in columns
+using ColumnRange = std::pair<int, int>;
+
+//------------------------------------------------------------------------
+// RIDFEngine
+//------------------------------------------------------------------------
+// Compares images against a set of trained snapshots at every rotation. As in BoB robotics' InSilicoRotater,
+// rotation r compares each snapshot against the image rolled left by r columns, i.e. image column (x + r) % width
+// is compared against snapshot column x. Differences are in pixel units i.e. [0, 255]
+class RIDFEngine
+{
+public:
+    RIDFEngine(const cv::Size &imSize);
+    virtual ~RIDFEngine();
+
+    // Name of engine used by Perfect Memory types unless another is specified
+    static constexpr const char *defaultName = "Direct";
+
+    //------------------------------------------------------------------------
+    // Declared virtuals
+    //------------------------------------------------------------------------
+    virtual void train(const cv::Mat &snapshot) = 0;
+    virtual size_t getNumSnapshots() const = 0;
+
+    // Create a copy of this engine to use on another thread. The copy shares this engine's trained snapshots,
+    // which can't be trained on any further, but has its own scratch buffers
+    virtual std::unique_ptr<RIDFEngine> clone() const = 0;
+
+    // Get 'matrix' of differences between image and the listed snapshots at every rotation, indexed
+    // [index into snapshots][rotation]. Only the listed snapshots are compared
+    virtual const std::vector<std::vector<float>> &getImageDifferences(const cv::Mat &image, const std::vector<size_t> &snapshots) const = 0;
+
+    // Get lowest difference across all snapshots at each rotation within columnRanges and the (lowest) index of the
+    // snapshot it came from. Rotations outside of columnRanges may be skipped and are set to float max
+    virtual void calculateColumnMinima(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                       std::vector<float> &lowestDifferences, std::vector<size_t> &bestSnapshots) const;
+
+    // Find the snapshot and rotation within columnRanges with the lowest difference, returning the snapshot index,
+    // rotation and difference. Ties are won by the lowest snapshot index and then the lowest rotation
+    virtual std::tuple<size_t, int, float> findBestMatch(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges) const;
+
+    // Find the best match in the same way but only considering the listed snapshots
+    virtual std::tuple<size_t, int, float> findBestMatch(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                                         const std::vector<size_t> &snapshots) const;
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    // Get 'matrix' of differences between image and every snapshot at every rotation, indexed [snapshot][rotation]
+    const std::vector<std::vector<float>> &getImageDifferences(const cv::Mat &image) const;
+
+    // Get lowest difference across all snapshots at every rotation and the (lowest) index of the snapshot it came from
+    void calculateColumnMinima(const cv::Mat &image, std::vector<float> &lowestDifferences,
+                               std::vector<size_t> &bestSnapshots) const;
+
+    const cv::Size &getImageSize() const{ return m_ImageSize; }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const cv::Size m_ImageSize;
+
+    // Scratch buffer listing every snapshot
+    mutable std::vector<size_t> m_ScratchAllSnapshots;
+};
+
+//------------------------------------------------------------------------
+// RIDFEngineDirect
+//------------------------------------------------------------------------
+// Mean absolute difference calculated directly for every rotation in the same way as BoB robotics'
+// PerfectMemoryRotater - the image is rolled and compared against each snapshot with cv::absdiff and cv::mean
+class RIDFEngineDirect : public RIDFEngine
+{
+public:
+    RIDFEngineDirect(const cv::Size &imSize);
+
+    //------------------------------------------------------------------------
+    // RIDFEngine virtuals
+    //------------------------------------------------------------------------
+    virtual void train(const cv::Mat &snapshot) override;
+    virtual size_t getNumSnapshots() const override{ return m_Snapshots->size(); }
+    virtual std::unique_ptr<RIDFEngine> clone() const override;
+    virtual const std::vector<std::vector<float>> &getImageDifferences(const cv::Mat &image, const std::vector<size_t> &snapshots) const override;
+
+    using RIDFEngine::getImageDifferences;
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // Snapshots, shared with copies of engine
+    std::shared_ptr<std::vector<cv::Mat>> m_Snapshots;
+
+    // Scratch buffers
+    mutable cv::Mat m_ScratchRolledImage;
+    mutable cv::Mat m_ScratchDifferenceImage;
+    mutable std::vector<std::vector<float>> m_Differences;
+};
+
+//------------------------------------------------------------------------
+// RIDFEngineFused
+//------------------------------------------------------------------------
+// Mean absolute difference, matching RIDFEngineDirect, but calculated by a fused kernel which keeps a running minimum
+// and argmin per rotation rather than materialising the snapshots x rotations difference matrix. Snapshots are
+// processed in tiles sized to stay in L2 cache while every rotation of the image is streamed over them and
+// differences are accumulated exactly in integers on the packed 8-bit pixels using SIMD sumAbsoluteDifferences
+class RIDFEngineFused : public RIDFEngine
+{
+public:
+    RIDFEngineFused(const cv::Size &imSize);
+
+    //------------------------------------------------------------------------
+    // RIDFEngine virtuals
+    //------------------------------------------------------------------------
+    virtual void train(const cv::Mat &snapshot) override;
+    virtual size_t getNumSnapshots() const override{ return m_NumSnapshots; }
+    virtual std::unique_ptr<RIDFEngine> clone() const override;
+    virtual const std::vector<std::vector<float>> &getImageDifferences(const cv::Mat &image, const std::vector<size_t> &snapshots) const override;
+    virtual void calculateColumnMinima(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                       std::vector<float> &lowestDifferences, std::vector<size_t> &bestSnapshots) const override;
+    virtual std::tuple<size_t, int, float> findBestMatch(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges,
+                                                         const std::vector<size_t> &snapshots) const override;
+
+    using RIDFEngine::calculateColumnMinima;
+    using RIDFEngine::findBestMatch;
+    using RIDFEngine::getImageDifferences;
+
+protected:
+    //------------------------------------------------------------------------
+    // Protected API
+    //------------------------------------------------------------------------
+    // Copy each row of image twice into m_ScratchDoubledImage so that any rotation of a row is contiguous
+    void buildDoubledImage(const cv::Mat &image) const;
+
+    // Get sum of absolute differences between snapshot and doubled image at rotation. If, after any row,
+    // the partial sum exceeds abandonThreshold, the partial sum is returned immediately
+    uint32_t calculateSAD(size_t snapshot, int rotation,
+                          uint32_t abandonThreshold = std::numeric_limits<uint32_t>::max()) const;
+
+    // Get pointer to start of snapshot's pixels
+    const uint8_t *getSnapshot(size_t snapshot) const{ return &(*m_Snapshots)[snapshot * getImageSize().area()]; }
+
+    // Convert sum of absolute differences into mean difference, scaling in the same way as cv::mean
+    float getMeanDifference(uint32_t sad) const{ return (float)((double)sad * (1.0 / (double)getImageSize().area())); }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // Number of snapshots to process in each tile
+    const size_t m_TileSize;
+
+    // Snapshots stored contiguously, shared with copies of engine
+    size_t m_NumSnapshots;
+    std::shared_ptr<std::vector<uint8_t>> m_Snapshots;
+
+    // Scratch buffers
+    mutable std::vector<uint8_t> m_ScratchDoubledImage;
+    mutable std::vector<std::vector<float>> m_Differences;
+};
+
+//------------------------------------------------------------------------
+// RIDFEngineEarlyAbandon
+//------------------------------------------------------------------------
+// Exact best match search which avoids summing most candidate snapshots and rotations over all pixels. The search is
+// seeded with the snapshots around the previous best match. Each remaining snapshot's lowest possible sum of absolute
+// differences, at any rotation, is then bounded by the smallest difference between its and the rotated image's
+// column sums. Snapshots are taken from a heap in order of this bound and every rotation evaluated, abandoning each
+// as soon as its partial sum exceeds the best found so far, until the bound exceeds the best. Results are identical
+// to RIDFEngineFused
+class RIDFEngineEarlyAbandon : public RIDFEngineFused
+{
+public:
+    RIDFEngineEarlyAbandon(const cv::Size &imSize, size_t seedWindow = 2);
+
+    //------------------------------------------------------------------------
+    // RIDFEngine virtuals
+    //------------------------------------------------------------------------
+    virtual void train(const cv::Mat &snapshot) override;
+    virtual std::unique_ptr<RIDFEngine> clone() const override;
+    virtual std::tuple<size_t, int, float> findBestMatch(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges) const override;
+
+    using RIDFEngineFused::findBestMatch;
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    // Calculate sum of each column of image
+    void calculateColumnSums(const uint8_t *pixels, std::vector<uint32_t> &columnSums) const;
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // Number of snapshots either side of previous best snapshot which are evaluated first
+    const size_t m_SeedWindow;
+
+    // Column sums of each snapshot, stored contiguously and shared with copies of engine
+    std::shared_ptr<std::vector<uint32_t>> m_SnapshotColumnSums;
+
+    // Snapshot index of previous best match
+    mutable size_t m_PreviousBestSnapshot;
+
+    // Scratch buffers
+    mutable std::vector<uint32_t> m_ScratchColumnSums;
+    mutable std::vector<std::pair<uint32_t, size_t>> m_ScratchCandidates;
+};
+
+//------------------------------------------------------------------------
+// RIDFEnginePrefilter
+//------------------------------------------------------------------------
+// Best match search which shortlists snapshots using a rotation-invariant signature - each row's pixels in sorted
+// order. Rotating an image only permutes the pixels within each row and matching sorted values minimises the sum of
+// absolute differences over all permutations, so the SAD between two sets of sorted rows is a lower bound on the SAD
+// at every rotation. If numCandidates is zero, snapshots are evaluated in order of this bound until it exceeds the
+// best so results are identical to RIDFEngineFused. Otherwise, only the numCandidates snapshots with the lowest
+// bounds are evaluated, trading accuracy for speed on large memories
+class RIDFEnginePrefilter : public RIDFEngineFused
+{
+public:
+    RIDFEnginePrefilter(const cv::Size &imSize, size_t numCandidates = 0);
+
+    //------------------------------------------------------------------------
+    // RIDFEngine virtuals
+    //------------------------------------------------------------------------
+    virtual void train(const cv::Mat &snapshot) override;
+    virtual std::unique_ptr<RIDFEngine> clone() const override;
+    virtual std::tuple<size_t, int, float> findBestMatch(const cv::Mat &image, const std::vector<ColumnRange> &columnRanges) const override;
+
+    using RIDFEngineFused::findBestMatch;
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // Number of snapshots to evaluate fully (zero to evaluate all that might be the best match)
+    const size_t m_NumCandidates;
+
+    // Sorted rows of each snapshot, stored contiguously and shared with copies of engine
+    std::shared_ptr<std::vector<uint8_t>> m_SortedSnapshots;
+
+    // Scratch buffers
+    mutable std::vector<uint8_t> m_ScratchSortedImage;
+    mutable std::vector<std::pair<uint32_t, size_t>> m_ScratchCandidates;
+};
+
+//------------------------------------------------------------------------
+// RIDFEngineFFT
+//------------------------------------------------------------------------
+// Root mean square difference at every rotation calculated using FFTs. Because rotations only permute columns, the
+// squared difference at rotation r is the energy of both images minus twice their circular cross-correlation at r,
+// summed across rows. The cross-correlation for all rotations is obtained from the product of the row spectra, summed
+// across rows, followed by a single inverse FFT so each comparison is O(W.H + W log W) rather than O(W^2.H).
+// **NOTE** only squared differences decompose like this so results match a direct root mean square difference
+// calculation (to within float precision) rather than the mean absolute difference calculated by RIDFEngineDirect.
+// Memories are therefore only created with this engine if MemoryParameters::allowRMS is set
+class RIDFEngineFFT : public RIDFEngine
+{
+public:
+    RIDFEngineFFT(const cv::Size &imSize);
+
+    //------------------------------------------------------------------------
+    // RIDFEngine virtuals
+    //------------------------------------------------------------------------
+    virtual void train(const cv::Mat &snapshot) override;
+    virtual size_t getNumSnapshots() const override{ return m_SnapshotEnergies->size(); }
+    virtual std::unique_ptr<RIDFEngine> clone() const override;
+    virtual const std::vector<std::vector<float>> &getImageDifferences(const cv::Mat &image, const std::vector<size_t> &snapshots) const override;
+
+    using RIDFEngine::getImageDifferences;
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    // Calculate non-redundant half of spectrum of each row of image and return image's energy
+    double calculateSpectrum(const cv::Mat &image, std::vector<std::complex<float>> &spectrum) const;
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    // Number of non-redundant frequencies in spectrum of each row
+    const int m_NumFrequencies;
+
+    // Row spectra and energies of snapshots, shared with copies of engine
+    std::shared_ptr<std::vector<std::vector<std::complex<float>>>> m_SnapshotSpectra;
+    std::shared_ptr<std::vector<double>> m_SnapshotEnergies;
+
+    // Scratch buffers
+    mutable cv::Mat m_ScratchFloatImage;
+    mutable cv::Mat m_ScratchRowSpectra;
+    mutable std::vector<std::complex<float>> m_ScratchImageSpectrum;
+    mutable cv::Mat m_ScratchCrossSpectrum;
+    mutable cv::Mat m_ScratchCrossCorrelation;
+    mutable std::vector<std::vector<float>> m_Differences;
+};
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+// Roll each row of image left by pixels in the same way as BoB robotics' InSilicoRotater
+void rollImage(const cv::Mat &image, cv::Mat &rolledImage, int pixels);
+
+// Sort pixels within each row of a continuous image. This is a rotation-invariant signature of the image and the sum
+// of absolute differences between two images' sorted rows is a lower bound on their SAD at every rotation
+void sortRows(const uint8_t *pixels, const cv::Size &imSize, uint8_t *sortedPixels);
+
+// Create RIDF engine by name. numCandidates is only used by the Prefilter engine
+std::unique_ptr<RIDFEngine> createRIDFEngine(const std::string &name, const cv::Size &imSize, size_t numCandidates = 0);
@@ -0,0 +1,621 @@
+#include "route.h"
+
+// Standard C++ includes
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <string>
+
+// POSIX includes
+#include <unistd.h>
+
+// PSimpl includes
+#include "psimpl.h"
+
+// BoB robotics includes
+#include "common/assert.h"
+
+#include "cpu_features.h"
+#include "hash.h"
+
+using namespace BoBRobotics;
+using namespace units::length;
+using namespace units::angle;
+
+//------------------------------------------------------------------------
+// Anonymous namespace
+//------------------------------------------------------------------------
+namespace
+{
+// Get squared distance from point to nearest point on segment
+inline float getNearestPointOnSegment(const cv::Point2f &point, const cv::Point2f &segmentStart, const cv::Point2f &segmentEnd,
+                                      cv::Point2f &nearestPointOnSegment)
+{
+    // Get vector pointing along segment and it's squared
+    const cv::Point2f segmentVector = segmentEnd - segmentStart;
+    const float segmentLengthSquared = segmentVector.dot(segmentVector);
+
+    // Get vector from start of segment to point
+    const cv::Point2f segmentStartToPoint = point - segmentStart;
+
+    // Take dot product of two vectors and normalise, clamping at 0 and 1
+    const float t = std::max(0.0f, std::min(1.0f, segmentStartToPoint.dot(segmentVector) / segmentLengthSquared));
+
+    // Find nearest point on the segment
+    nearestPointOnSegment = segmentStart + (t * segmentVector);
+
+    // Get the vector from here to our point and hence the squared distance
+    const cv::Point2f shortestSegmentToPoint = point - nearestPointOnSegment;
+    return shortestSegmentToPoint.dot(shortestSegmentToPoint);
+}
+//------------------------------------------------------------------------
+NearestRoutePoint makeNearestRoutePoint(float shortestDistanceSquared, const cv::Point2f &nearestPoint, size_t nearestSegment,
+                                        const std::vector<cv::Point2f> &routePoints)
+{
+    // Get vector in direction of nearest segment and hence heading
+    const cv::Point2f nearestSegmentVector = routePoints[nearestSegment + 1] - routePoints[nearestSegment];
+    const degree_t nearestSegmentHeading = radian_t(std::atan2(nearestSegmentVector.y, nearestSegmentVector.x));
+
+    // Return shortest distance and position of nearest point
+    return std::make_tuple(centimeter_t(std::sqrt(shortestDistanceSquared)), nearestPoint, nearestSegment, nearestSegmentHeading);
+}
+//------------------------------------------------------------------------
+uint64_t hashRoute(const std::vector<cv::Point2f> &routePoints)
+{
+    FNV1AHash hash;
+    hash.update(routePoints.size());
+    hash.update(routePoints.data(), routePoints.size() * sizeof(cv::Point2f));
+    return hash.get();
+}
+//------------------------------------------------------------------------
+#ifdef SIMD_X86
+// Scan segments [begin, end), whose structure-of-arrays data is padded to a multiple of 8, 8 at a time using AVX2
+// updating shortest squared distance and nearest segment if any are closer
+SIMD_TARGET("avx2") void scanSegmentsAVX2(const cv::Point2f &point, size_t begin, size_t end, const float *startX, const float *startY,
+                                          const float *vectorX, const float *vectorY, const float *lengthSquared,
+                                          float &shortestDistanceSquared, size_t &nearestSegment)
+{
+    const __m256 pointX = _mm256_set1_ps(point.x);
+    const __m256 pointY = _mm256_set1_ps(point.y);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    // Each lane tracks the nearest of the segments it has seen - as segment indices increase,
+    // a strict comparison means each lane keeps the lowest index amongst ties
+    __m256 laneShortest = _mm256_set1_ps(std::numeric_limits<float>::max());
+    __m256i laneNearest = _mm256_set1_epi32(-1);
+    __m256i segmentIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    segmentIndex = _mm256_add_epi32(segmentIndex, _mm256_set1_epi32((int)begin));
+    const __m256i eight = _mm256_set1_epi32(8);
+    for(size_t i = begin; i < end; i += 8) {
+        const __m256 startX256 = _mm256_loadu_ps(startX + i);
+        const __m256 startY256 = _mm256_loadu_ps(startY + i);
+        const __m256 vectorX256 = _mm256_loadu_ps(vectorX + i);
+        const __m256 vectorY256 = _mm256_loadu_ps(vectorY + i);
+        const __m256 lengthSquared256 = _mm256_loadu_ps(lengthSquared + i);
+
+        // Take dot product of vector from start of segment to point and segment, normalise and clamp at 0 and 1
+        const __m256 startToPointX = _mm256_sub_ps(pointX, startX256);
+        const __m256 startToPointY = _mm256_sub_ps(pointY, startY256);
+        const __m256 dot = _mm256_add_ps(_mm256_mul_ps(startToPointX, vectorX256), _mm256_mul_ps(startToPointY, vectorY256));
+        const __m256 t = _mm256_max_ps(zero, _mm256_min_ps(one, _mm256_div_ps(dot, lengthSquared256)));
+
+        // Find nearest point on segments and squared distance from it to point
+        const __m256 toPointX = _mm256_sub_ps(pointX, _mm256_add_ps(startX256, _mm256_mul_ps(t, vectorX256)));
+        const __m256 toPointY = _mm256_sub_ps(pointY, _mm256_add_ps(startY256, _mm256_mul_ps(t, vectorY256)));
+        const __m256 distanceSquared = _mm256_add_ps(_mm256_mul_ps(toPointX, toPointX), _mm256_mul_ps(toPointY, toPointY));
+
+        // Update lanes where this segment is nearer
+        const __m256 nearer = _mm256_cmp_ps(distanceSquared, laneShortest, _CMP_LT_OQ);
+        laneShortest = _mm256_blendv_ps(laneShortest, distanceSquared, nearer);
+        laneNearest = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(laneNearest), _mm256_castsi256_ps(segmentIndex), nearer));
+        segmentIndex = _mm256_add_epi32(segmentIndex, eight);
+    }
+
+    // Reduce lanes, breaking ties on lowest index
+    alignas(32) float laneShortestArray[8];
+    alignas(32) int32_t laneNearestArray[8];
+    _mm256_store_ps(laneShortestArray, laneShortest);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(laneNearestArray), laneNearest);
+    for(int l = 0; l < 8; l++) {
+        const size_t i = (size_t)laneNearestArray[l];
+        if(laneNearestArray[l] >= 0 && (laneShortestArray[l] < shortestDistanceSquared
+            || (laneShortestArray[l] == shortestDistanceSquared && i < nearestSegment)))
+        {
+            shortestDistanceSquared = laneShortestArray[l];
+            nearestSegment = i;
+        }
+    }
+}
+#endif
+
+// Header written at start of route raster cache files
+const char s_RouteRasterMagic[4] = {'R', 'R', 'S', 'T'};
+const int32_t s_RouteRasterVersion = 2;
+}   // Anonymous namespace
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+void processRoute(const Navigation::ImageDatabase &database, double decimate,
+                  cv::Mat &renderMatFull, cv::Mat &renderMatDecimated,
+                  std::vector<cv::Point2f> &decimatedPoints)
+{
+
+    std::vector<float> routePointComponents;
+    routePointComponents.reserve(database.size() * 2);
+
+    {
+        // Reserve temporary vector to hold route points, snapped to integer pixels
+        std::vector<cv::Point2i> routePointPixels;
+        routePointPixels.reserve(database.size());
+
+        // Loop through route
+        for(const auto &r : database) {
+            // Get position of point in cm
+            const centimeter_t x = r.position[0];
+            const centimeter_t y = r.position[1];
+
+            // Add x and y components of position to vector
+            routePointComponents.emplace_back(x.value());
+            routePointComponents.emplace_back(y.value());
+
+            // Add x and y pixel values
+            routePointPixels.emplace_back((int)std::round(x.value()), (int)std::round(y.value()));
+        }
+
+        // Build render matrix from route point pixels
+        renderMatFull = cv::Mat(routePointPixels, true);
+    }
+
+    // Decimate route points
+    std::vector<float> decimatedRoutePointComponents;
+    psimpl::simplify_douglas_peucker<2>(routePointComponents.cbegin(), routePointComponents.cend(),
+                                        decimate,
+                                        std::back_inserter(decimatedRoutePointComponents));
+
+    decimatedPoints.reserve(decimatedRoutePointComponents.size() / 2);
+
+    {
+        // Reserve temporary vector to hold decimated route points, snapped to integer pixels
+        std::vector<cv::Point2i> decimatedPixels;
+        decimatedPixels.reserve(decimatedRoutePointComponents.size() / 2);
+
+        for(size_t i = 0; i < decimatedRoutePointComponents.size(); i += 2) {
+            const float x = decimatedRoutePointComponents[i];
+            const float y = decimatedRoutePointComponents[i + 1];
+
+            decimatedPixels.emplace_back((int)std::round(x), (int)std::round(y));
+
+            decimatedPoints.emplace_back(x, y);
+        }
+
+        // Build render matrix from decimated pixels
+        renderMatDecimated = cv::Mat(decimatedPixels, true);
+    }
+}
+//------------------------------------------------------------------------
+NearestRoutePoint getNearestPointOnRoute(const cv::Point2f &point, const std::vector<cv::Point2f> &routePoints)
+{
+    // Loop through points
+    float shortestDistanceSquared = std::numeric_limits<float>::max();
+    cv::Point2f nearestPoint;
+    size_t nearestSegment;
+    for(size_t i = 0; i < (routePoints.size() - 1); i++) {
+        // Get nearest point on segment and squared distance to it
+        cv::Point2f nearestPointOnSegment;
+        const float distanceSquared = getNearestPointOnSegment(point, routePoints[i], routePoints[i + 1], nearestPointOnSegment);
+
+        // If this is shorter than current best, update current
+        if(distanceSquared < shortestDistanceSquared) {
+            shortestDistanceSquared = distanceSquared;
+            nearestPoint = nearestPointOnSegment;
+            nearestSegment = i;
+        }
+    }
+
+    return makeNearestRoutePoint(shortestDistanceSquared, nearestPoint, nearestSegment, routePoints);
+}
+
+//------------------------------------------------------------------------
+// RouteSegmentIndex
+//------------------------------------------------------------------------
+RouteSegmentIndex::RouteSegmentIndex(const std::vector<cv::Point2f> &routePoints, float cellSize)
+:   m_RoutePoints(routePoints), m_CellSize(cellSize)
+{
+    BOB_ASSERT(routePoints.size() > 1);
+
+    // Calculate bounding box of route
+    cv::Point2f minPoint(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    cv::Point2f maxPoint(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+    for(const auto &p : routePoints) {
+        minPoint.x = std::min(minPoint.x, p.x);
+        minPoint.y = std::min(minPoint.y, p.y);
+        maxPoint.x = std::max(maxPoint.x, p.x);
+        maxPoint.y = std::max(maxPoint.y, p.y);
+    }
+
+    // If no cell size is specified, pick one so there are roughly as many cells as segments
+    const size_t numSegments = routePoints.size() - 1;
+    const float width = std::max(1.0f, maxPoint.x - minPoint.x);
+    const float height = std::max(1.0f, maxPoint.y - minPoint.y);
+    if(m_CellSize <= 0.0f) {
+        m_CellSize = std::max(1.0f, std::sqrt((width * height) / (float)numSegments));
+    }
+
+    m_Origin = minPoint;
+    m_NumCellsX = (int)std::floor(width / m_CellSize) + 1;
+    m_NumCellsY = (int)std::floor(height / m_CellSize) + 1;
+
+    // Get range of cells overlapped by each segment's bounding box
+    std::vector<cv::Rect> segmentCells;
+    segmentCells.reserve(numSegments);
+    for(size_t i = 0; i < numSegments; i++) {
+        const int startX = getCellX(std::min(routePoints[i].x, routePoints[i + 1].x));
+        const int endX = getCellX(std::max(routePoints[i].x, routePoints[i + 1].x));
+        const int startY = getCellY(std::min(routePoints[i].y, routePoints[i + 1].y));
+        const int endY = getCellY(std::max(routePoints[i].y, routePoints[i + 1].y));
+        segmentCells.emplace_back(startX, startY, endX - startX + 1, endY - startY + 1);
+    }
+
+    // Count segments in each cell
+    m_CellStart.resize((m_NumCellsX * m_NumCellsY) + 1, 0);
+    for(const auto &r : segmentCells) {
+        for(int y = r.y; y < (r.y + r.height); y++) {
+            for(int x = r.x; x < (r.x + r.width); x++) {
+                m_CellStart[(y * m_NumCellsX) + x + 1]++;
+            }
+        }
+    }
+
+    // Convert counts into start indices
+    std::partial_sum(m_CellStart.cbegin(), m_CellStart.cend(), m_CellStart.begin());
+
+    // Fill cells with segment indices - as segments are added in order, each cell's list is sorted
+    std::vector<unsigned int> cellEnd(m_CellStart.cbegin(), m_CellStart.cend() - 1);
+    m_CellSegments.resize(m_CellStart.back());
+    for(size_t i = 0; i < numSegments; i++) {
+        const auto &r = segmentCells[i];
+        for(int y = r.y; y < (r.y + r.height); y++) {
+            for(int x = r.x; x < (r.x + r.width); x++) {
+                m_CellSegments[cellEnd[(y * m_NumCellsX) + x]++] = (unsigned int)i;
+            }
+        }
+    }
+}
+//------------------------------------------------------------------------
+NearestRoutePoint RouteSegmentIndex::getNearestPoint(const cv::Point2f &point) const
+{
+    // Get cell containing point, clamped to grid
+    const int cellX = getCellX(point.x);
+    const int cellY = getCellY(point.y);
+
+    float shortestDistanceSquared = std::numeric_limits<float>::max();
+    cv::Point2f nearestPoint;
+    size_t nearestSegment = std::numeric_limits<size_t>::max();
+
+    // Search rings of cells outward from point
+    const int maxRing = std::max(std::max(cellX, m_NumCellsX - 1 - cellX), std::max(cellY, m_NumCellsY - 1 - cellY));
+    for(int ring = 0; ring <= maxRing; ring++) {
+        // Any segment not yet visited lies in a cell at least (ring - 1) cells away from the point. Stop once this
+        // bound exceeds the current best distance, leaving an extra ring of slack so segments which tie with the
+        // current best, within floating point error, are still visited and the lowest index wins as in a linear scan
+        if(nearestSegment != std::numeric_limits<size_t>::max()) {
+            const float ringDistance = (float)(ring - 2) * m_CellSize;
+            if(ringDistance > 0.0f && (ringDistance * ringDistance) > shortestDistanceSquared) {
+                break;
+            }
+        }
+
+        // Loop through cells in ring, clipped to grid
+        const int startY = std::max(0, cellY - ring);
+        const int endY = std::min(m_NumCellsY - 1, cellY + ring);
+        const int startX = std::max(0, cellX - ring);
+        const int endX = std::min(m_NumCellsX - 1, cellX + ring);
+        for(int y = startY; y <= endY; y++) {
+            // On the top and bottom rows of the ring visit every cell, otherwise only the two sides
+            const bool edgeRow = (std::abs(y - cellY) == ring);
+            const int stepX = edgeRow ? 1 : std::max(1, 2 * ring);
+            for(int x = edgeRow ? startX : (cellX - ring); x <= endX; x += stepX) {
+                if(x < startX) {
+                    continue;
+                }
+
+                // Loop through segments in cell
+                const size_t c = (y * m_NumCellsX) + x;
+                for(unsigned int s = m_CellStart[c]; s < m_CellStart[c + 1]; s++) {
+                    const size_t i = m_CellSegments[s];
+
+                    // Get nearest point on segment and squared distance to it
+                    cv::Point2f nearestPointOnSegment;
+                    const float distanceSquared = getNearestPointOnSegment(point, m_RoutePoints[i], m_RoutePoints[i + 1],
+                                                                           nearestPointOnSegment);
+
+                    // If this is shorter than current best or ties with it but occurs earlier in the route, update current
+                    if(distanceSquared < shortestDistanceSquared
+                        || (distanceSquared == shortestDistanceSquared && i < nearestSegment))
+                    {
+                        shortestDistanceSquared = distanceSquared;
+                        nearestPoint = nearestPointOnSegment;
+                        nearestSegment = i;
+                    }
+                }
+            }
+        }
+    }
+
+    return makeNearestRoutePoint(shortestDistanceSquared, nearestPoint, nearestSegment, m_RoutePoints);
+}
+//------------------------------------------------------------------------
+int RouteSegmentIndex::getCellX(float x) const
+{
+    return std::min(m_NumCellsX - 1, std::max(0, (int)std::floor((x - m_Origin.x) / m_CellSize)));
+}
+//------------------------------------------------------------------------
+int RouteSegmentIndex::getCellY(float y) const
+{
+    return std::min(m_NumCellsY - 1, std::max(0, (int)std::floor((y - m_Origin.y) / m_CellSize)));
+}
+
+//------------------------------------------------------------------------
+// RouteSegments
+//------------------------------------------------------------------------
+RouteSegments::RouteSegments(const std::vector<cv::Point2f> &routePoints)
+:   m_RoutePoints(routePoints), m_NumSegments(routePoints.size() - 1)
+{
+    BOB_ASSERT(routePoints.size() > 1);
+
+    // Pad arrays with segments so far away they can never be nearest
+    const size_t paddedNumSegments = ((m_NumSegments + 7) / 8) * 8;
+    m_StartX.resize(paddedNumSegments, 1.0E15f);
+    m_StartY.resize(paddedNumSegments, 1.0E15f);
+    m_VectorX.resize(paddedNumSegments, 0.0f);
+    m_VectorY.resize(paddedNumSegments, 0.0f);
+    m_LengthSquared.resize(paddedNumSegments, 1.0f);
+
+    for(size_t i = 0; i < m_NumSegments; i++) {
+        const cv::Point2f segmentVector = routePoints[i + 1] - routePoints[i];
+        m_StartX[i] = routePoints[i].x;
+        m_StartY[i] = routePoints[i].y;
+        m_VectorX[i] = segmentVector.x;
+        m_VectorY[i] = segmentVector.y;
+        m_LengthSquared[i] = segmentVector.dot(segmentVector);
+    }
+}
+//------------------------------------------------------------------------
+NearestRoutePoint RouteSegments::getNearestPoint(const cv::Point2f &point) const
+{
+    float shortestDistanceSquared = std::numeric_limits<float>::max();
+    size_t nearestSegment = 0;
+    scanSegments(point, 0, m_StartX.size(), shortestDistanceSquared, nearestSegment);
+
+    // Recalculate nearest point on winning segment
+    cv::Point2f nearestPoint;
+    getNearestPointOnSegment(point, m_RoutePoints[nearestSegment], m_RoutePoints[nearestSegment + 1], nearestPoint);
+    return makeNearestRoutePoint(shortestDistanceSquared, nearestPoint, nearestSegment, m_RoutePoints);
+}
+//------------------------------------------------------------------------
+void RouteSegments::getNearestPoints(const std::vector<cv::Point2f> &points, std::vector<NearestRoutePoint> &nearestPoints) const
+{
+    // 5 arrays of 512 floats = 10KiB of segment data per block
+    constexpr size_t blockSize = 512;
+
+    std::vector<float> shortestDistancesSquared(points.size(), std::numeric_limits<float>::max());
+    std::vector<size_t> nearestSegments(points.size(), 0);
+
+    // Loop through blocks of segments and scan each one against all points
+    // **NOTE** as blocks are processed in order, the lowest index still wins ties
+    for(size_t begin = 0; begin < m_StartX.size(); begin += blockSize) {
+        const size_t end = std::min(m_StartX.size(), begin + blockSize);
+        for(size_t p = 0; p < points.size(); p++) {
+            scanSegments(points[p], begin, end, shortestDistancesSquared[p], nearestSegments[p]);
+        }
+    }
+
+    // Recalculate nearest point on winning segments
+    nearestPoints.clear();
+    nearestPoints.reserve(points.size());
+    for(size_t p = 0; p < points.size(); p++) {
+        cv::Point2f nearestPoint;
+        getNearestPointOnSegment(points[p], m_RoutePoints[nearestSegments[p]], m_RoutePoints[nearestSegments[p] + 1], nearestPoint);
+        nearestPoints.push_back(makeNearestRoutePoint(shortestDistancesSquared[p], nearestPoint, nearestSegments[p], m_RoutePoints));
+    }
+}
+//------------------------------------------------------------------------
+void RouteSegments::scanSegments(const cv::Point2f &point, size_t begin, size_t end,
+                                 float &shortestDistanceSquared, size_t &nearestSegment) const
+{
+#ifdef SIMD_X86
+    // Scan 8 segments at a time if CPU supports AVX2
+    if(hasAVX2()) {
+        scanSegmentsAVX2(point, begin, end, m_StartX.data(), m_StartY.data(), m_VectorX.data(), m_VectorY.data(), m_LengthSquared.data(),
+                         shortestDistanceSquared, nearestSegment);
+        return;
+    }
+#endif
+
+    for(size_t i = begin; i < end; i++) {
+        // Take dot product of vector from start of segment to point and segment, normalise and clamp at 0 and 1
+        const float startToPointX = point.x - m_StartX[i];
+        const float startToPointY = point.y - m_StartY[i];
+        const float dot = (startToPointX * m_VectorX[i]) + (startToPointY * m_VectorY[i]);
+        const float t = std::max(0.0f, std::min(1.0f, dot / m_LengthSquared[i]));
+
+        // Find nearest point on segment and squared distance from it to point
+        const float toPointX = point.x - (m_StartX[i] + (t * m_VectorX[i]));
+        const float toPointY = point.y - (m_StartY[i] + (t * m_VectorY[i]));
+        const float distanceSquared = (toPointX * toPointX) + (toPointY * toPointY);
+
+        // If this is shorter than current best, update current
+        if(distanceSquared < shortestDistanceSquared) {
+            shortestDistanceSquared = distanceSquared;
+            nearestSegment = i;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+// RouteRaster
+//------------------------------------------------------------------------
+RouteRaster::RouteRaster(const std::vector<cv::Point2f> &routePoints, const cv::Size &canvasSize,
+                         const filesystem::path &cachePath)
+:   m_RoutePoints(routePoints)
+{
+    BOB_ASSERT(routePoints.size() > 1);
+
+    // Pad canvas to cover the rounded position of every route point so no segment is clipped when it is drawn
+    cv::Rect canvas(cv::Point(0, 0), canvasSize);
+    for(const auto &p : routePoints) {
+        const cv::Point pixel((int)std::round(p.x), (int)std::round(p.y));
+        canvas |= cv::Rect(pixel, cv::Size(1, 1));
+    }
+    m_Origin = canvas.tl();
+
+    const uint64_t routeHash = hashRoute(routePoints);
+    if(!cachePath.empty() && cachePath.exists() && readCache(cachePath, canvas, routeHash)) {
+        std::cout << "Loaded route raster from " << cachePath << std::endl;
+    }
+    else {
+        build(canvas.size());
+
+        if(!cachePath.empty()) {
+            if(writeCache(cachePath, routeHash)) {
+                std::cout << "Wrote route raster to " << cachePath << std::endl;
+            }
+            else {
+                std::cerr << "Could not write route raster to " << cachePath << std::endl;
+            }
+        }
+    }
+}
+//------------------------------------------------------------------------
+NearestRoutePoint RouteRaster::getNearestPoint(const cv::Point2f &point) const
+{
+    // If point is outside padded canvas, search all segments
+    cv::Point pixel;
+    if(!getPixel(point, pixel)) {
+        return getNearestPointOnRoute(point, m_RoutePoints);
+    }
+
+    // Read nearest segment from label map
+    const size_t nearestSegment = (size_t)m_NearestSegment.at<int32_t>(pixel);
+
+    // Calculate exact nearest point on this segment
+    cv::Point2f nearestPoint;
+    const float distanceSquared = getNearestPointOnSegment(point, m_RoutePoints[nearestSegment], m_RoutePoints[nearestSegment + 1],
+                                                           nearestPoint);
+
+    return makeNearestRoutePoint(distanceSquared, nearestPoint, nearestSegment, m_RoutePoints);
+}
+//------------------------------------------------------------------------
+void RouteRaster::build(const cv::Size &canvasSize)
+{
+    // Draw each segment onto canvas, relative to its origin, labelled with its index plus one so zero is background
+    // **NOTE** where segments cross, the later segment wins
+    cv::Mat segmentLabels(canvasSize, CV_32SC1, cv::Scalar(0));
+    for(size_t i = 0; i < (m_RoutePoints.size() - 1); i++) {
+        const cv::Point start = cv::Point((int)std::round(m_RoutePoints[i].x), (int)std::round(m_RoutePoints[i].y)) - m_Origin;
+        const cv::Point end = cv::Point((int)std::round(m_RoutePoints[i + 1].x), (int)std::round(m_RoutePoints[i + 1].y)) - m_Origin;
+        cv::line(segmentLabels, start, end, cv::Scalar((double)(i + 1)));
+    }
+
+    // Label every pixel with the nearest route pixel using a distance transform - only the labels are used as queries
+    // calculate exact distances to the nearest segment
+    const cv::Mat notRoute = (segmentLabels == 0);
+    BOB_ASSERT(cv::countNonZero(notRoute) < (int)notRoute.total());
+    cv::Mat distance;
+    cv::Mat pixelLabels;
+    cv::distanceTransform(notRoute, distance, pixelLabels, cv::DIST_L2, cv::DIST_MASK_5, cv::DIST_LABEL_PIXEL);
+
+    // Build lookup from route pixel labels to the segment drawn at that pixel
+    std::vector<int32_t> labelSegments;
+    for(int y = 0; y < canvasSize.height; y++) {
+        for(int x = 0; x < canvasSize.width; x++) {
+            const int32_t segmentLabel = segmentLabels.at<int32_t>(y, x);
+            if(segmentLabel != 0) {
+                const size_t pixelLabel = (size_t)pixelLabels.at<int32_t>(y, x);
+                if(pixelLabel >= labelSegments.size()) {
+                    labelSegments.resize(pixelLabel + 1, 0);
+                }
+                labelSegments[pixelLabel] = segmentLabel - 1;
+            }
+        }
+    }
+
+    // Use lookup to convert pixel labels into nearest segment
+    m_NearestSegment.create(canvasSize, CV_32SC1);
+    for(int y = 0; y < canvasSize.height; y++) {
+        for(int x = 0; x < canvasSize.width; x++) {
+            m_NearestSegment.at<int32_t>(y, x) = labelSegments[pixelLabels.at<int32_t>(y, x)];
+        }
+    }
+}
+//------------------------------------------------------------------------
+bool RouteRaster::readCache(const filesystem::path &cachePath, const cv::Rect &canvas, uint64_t routeHash)
+{
+    std::ifstream is(cachePath.str(), std::ios::binary);
+    if(!is.good()) {
+        return false;
+    }
+
+    // Read header and check it matches
+    char magic[4];
+    int32_t version;
+    int32_t origin[2];
+    int32_t size[2];
+    uint64_t hash;
+    is.read(magic, sizeof(magic));
+    is.read(reinterpret_cast<char *>(&version), sizeof(version));
+    is.read(reinterpret_cast<char *>(origin), sizeof(origin));
+    is.read(reinterpret_cast<char *>(size), sizeof(size));
+    is.read(reinterpret_cast<char *>(&hash), sizeof(hash));
+    if(!is.good() || !std::equal(std::begin(magic), std::end(magic), std::begin(s_RouteRasterMagic))
+        || version != s_RouteRasterVersion || origin[0] != canvas.x || origin[1] != canvas.y
+        || size[0] != canvas.width || size[1] != canvas.height || hash != routeHash)
+    {
+        std::cerr << "Route raster cache " << cachePath << " does not match route - rebuilding" << std::endl;
+        return false;
+    }
+
+    // Read nearest segments
+    m_NearestSegment.create(canvas.size(), CV_32SC1);
+    is.read(reinterpret_cast<char *>(m_NearestSegment.data), m_NearestSegment.total() * sizeof(int32_t));
+    return is.good();
+}
+//------------------------------------------------------------------------
+bool RouteRaster::writeCache(const filesystem::path &cachePath, uint64_t routeHash) const
+{
+    // Write to temporary file and then rename so concurrent runs never see a partial cache
+    const std::string temporaryPath = cachePath.str() + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream os(temporaryPath, std::ios::binary);
+        const int32_t origin[2] = { m_Origin.x, m_Origin.y };
+        const int32_t size[2] = { m_NearestSegment.cols, m_NearestSegment.rows };
+        os.write(s_RouteRasterMagic, sizeof(s_RouteRasterMagic));
+        os.write(reinterpret_cast<const char *>(&s_RouteRasterVersion), sizeof(s_RouteRasterVersion));
+        os.write(reinterpret_cast<const char *>(origin), sizeof(origin));
+        os.write(reinterpret_cast<const char *>(size), sizeof(size));
+        os.write(reinterpret_cast<const char *>(&routeHash), sizeof(routeHash));
+        os.write(reinterpret_cast<const char *>(m_NearestSegment.data), m_NearestSegment.total() * sizeof(int32_t));
+        if(!os.good()) {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+    if(std::rename(temporaryPath.c_str(), cachePath.str().c_str()) != 0) {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+    else {
+        return true;
+    }
+}
+//------------------------------------------------------------------------
+bool RouteRaster::getPixel(const cv::Point2f &point, cv::Point &pixel) const
+{
+    pixel = cv::Point((int)std::round(point.x), (int)std::round(point.y)) - m_Origin;
+    return (pixel.x >= 0 && pixel.x < m_NearestSegment.cols && pixel.y >= 0 && pixel.y < m_NearestSegment.rows);
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+// Standard C++ includes
+#include <tuple>
+#include <vector>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// BoB robotics 3rd party includes
+#include "third_party/path.h"
+#include "third_party/units.h"
+
+// BoB robotics includes
+#include "navigation/image_database.h"
+
+// Distance to nearest point on route, nearest point, index of nearest segment and heading of nearest segment
+using NearestRoutePoint = std::tuple<units::length::centimeter_t, cv::Point2f, size_t, units::angle::degree_t>;
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+// Extract route points from database, render full and decimated routes and get decimated route points
+void processRoute(const BoBRobotics::Navigation::ImageDatabase &database, double decimate,
+                  cv::Mat &renderMatFull, cv::Mat &renderMatDecimated,
+                  std::vector<cv::Point2f> &decimatedPoints);
+
+// Get distance to route from point by scanning every segment
+NearestRoutePoint getNearestPointOnRoute(const cv::Point2f &point, const std::vector<cv::Point2f> &routePoints);
+
+//------------------------------------------------------------------------
+// RouteSegmentIndex
+//------------------------------------------------------------------------
+// Uniform grid over the bounding boxes of route segments. Queries search rings of cells
+// outwards from the query point and return exactly what getNearestPointOnRoute would
+class RouteSegmentIndex
+{
+public:
+    // If cellSize is zero, a cell size is picked so there are roughly as many cells as segments
+    RouteSegmentIndex(const std::vector<cv::Point2f> &routePoints, float cellSize = 0.0f);
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    NearestRoutePoint getNearestPoint(const cv::Point2f &point) const;
+
+    float getCellSize() const{ return m_CellSize; }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    int getCellX(float x) const;
+    int getCellY(float y) const;
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const std::vector<cv::Point2f> &m_RoutePoints;
+
+    // Origin, size and dimensions of grid
+    cv::Point2f m_Origin;
+    float m_CellSize;
+    int m_NumCellsX;
+    int m_NumCellsY;
+
+    // Indices of segments overlapping each cell, stored contiguously with
+    // the segments overlapping cell c stored between m_CellStart[c] and m_CellStart[c + 1]
+    std::vector<unsigned int> m_CellStart;
+    std::vector<unsigned int> m_CellSegments;
+};
+
+//------------------------------------------------------------------------
+// RouteSegments
+//------------------------------------------------------------------------
+// Structure-of-arrays copy of route segments which can be scanned 8 segments at a time using AVX2 (when the CPU
+// supports it) or with a scalar loop otherwise. Performs the same calculations as getNearestPointOnRoute
+// and, like it, breaks ties on the lowest segment index. Segment lengths are divided by rather than multiplied by
+// their reciprocal so the result is bit-identical to a linear scan (as long as the compiler doesn't contract the
+// scalar code into fused multiply-adds)
+class RouteSegments
+{
+public:
+    RouteSegments(const std::vector<cv::Point2f> &routePoints);
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    NearestRoutePoint getNearestPoint(const cv::Point2f &point) const;
+
+    // Find nearest points for many points at once, scanning blocks of segments which fit in L1 cache against all points
+    void getNearestPoints(const std::vector<cv::Point2f> &points, std::vector<NearestRoutePoint> &nearestPoints) const;
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    // Scan segments [begin, end) updating shortest squared distance and nearest segment if any are closer
+    void scanSegments(const cv::Point2f &point, size_t begin, size_t end,
+                      float &shortestDistanceSquared, size_t &nearestSegment) const;
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const std::vector<cv::Point2f> &m_RoutePoints;
+    const size_t m_NumSegments;
+
+    // Segment start points, vectors and squared lengths, padded to a multiple of 8 segments
+    std::vector<float> m_StartX;
+    std::vector<float> m_StartY;
+    std::vector<float> m_VectorX;
+    std::vector<float> m_VectorY;
+    std::vector<float> m_LengthSquared;
+};
+
+//------------------------------------------------------------------------
+// RouteRaster
+//------------------------------------------------------------------------
+// Nearest segment label map over a one pixel per cm canvas, calculated with a distance transform seeded from the
+// rasterised route. The canvas is padded to cover the whole route so no segment is clipped and every pixel is
+// labelled with the segment nearest to it. Queries fetch the nearest segment from the label map and then calculate
+// the exact nearest point on that segment so are O(1) but, where two segments are almost equidistant, may choose a
+// different segment to getNearestPointOnRoute. Points outside the padded canvas fall back to getNearestPointOnRoute
+class RouteRaster
+{
+public:
+    // If cachePath is not empty, raster is read from it if it matches padded canvas and route or written to it if not
+    RouteRaster(const std::vector<cv::Point2f> &routePoints, const cv::Size &canvasSize,
+                const filesystem::path &cachePath = filesystem::path());
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    NearestRoutePoint getNearestPoint(const cv::Point2f &point) const;
+
+    const cv::Mat &getNearestSegments() const{ return m_NearestSegment; }
+
+    // Position, in cm, of top-left pixel of padded canvas
+    const cv::Point &getOrigin() const{ return m_Origin; }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    void build(const cv::Size &canvasSize);
+    bool readCache(const filesystem::path &cachePath, const cv::Rect &canvas, uint64_t routeHash);
+    bool writeCache(const filesystem::path &cachePath, uint64_t routeHash) const;
+
+    // Get pixel containing point, returning false if it is outside the padded canvas
+    bool getPixel(const cv::Point2f &point, cv::Point &pixel) const;
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const std::vector<cv::Point2f> &m_RoutePoints;
+
+    // Position, in cm, of top-left pixel of padded canvas
+    cv::Point m_Origin;
+
+    // CV_32SC1 index of nearest segment
+    cv::Mat m_NearestSegment;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+// Standard C++ includes
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include "cpu_features.h"
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+#ifdef SIMD_X86
+// Sum absolute differences between pixels from i, 32 at a time using AVX2, advancing i past the pixels processed
+SIMD_TARGET("avx2") inline uint64_t sumAbsoluteDifferencesAVX2(const uint8_t *a, const uint8_t *b, size_t n, size_t &i)
+{
+    __m256i sad256 = _mm256_setzero_si256();
+    for(; (i + 32) <= n; i += 32) {
+        const __m256i a256 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        const __m256i b256 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        sad256 = _mm256_add_epi64(sad256, _mm256_sad_epu8(a256, b256));
+    }
+
+    // Sum 64-bit lanes
+    alignas(32) uint64_t lanes256[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes256), sad256);
+    return lanes256[0] + lanes256[1] + lanes256[2] + lanes256[3];
+}
+#endif
+
+// Exact sum of absolute differences between two arrays of 8-bit pixels. Uses AVX2 and/or SSE2 psadbw
+// instructions (which sum absolute differences of 8 bytes into 64-bit lanes) where the CPU supports them
+inline uint32_t sumAbsoluteDifferences(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    uint64_t sad = 0;
+
+#ifdef SIMD_X86
+    // Process 32 pixels at a time
+    if(hasAVX2()) {
+        sad += sumAbsoluteDifferencesAVX2(a, b, n, i);
+    }
+#endif
+
+#ifdef __SSE2__
+    // Process 16 pixels at a time
+    __m128i sad128 = _mm_setzero_si128();
+    for(; (i + 16) <= n; i += 16) {
+        const __m128i a128 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        const __m128i b128 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        sad128 = _mm_add_epi64(sad128, _mm_sad_epu8(a128, b128));
+    }
+
+    // Sum 64-bit lanes
+    alignas(16) uint64_t lanes128[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes128), sad128);
+    sad += lanes128[0] + lanes128[1];
+#endif
+
+    // Process remaining pixels
+    for(; i < n; i++) {
+        sad += (uint64_t)std::abs((int)a[i] - (int)b[i]);
+    }
+
+    return (uint32_t)sad;
+}
@@ -0,0 +1,260 @@
+#include "snapshot_cache.h"
+
+// Standard C++ includes
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// POSIX includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// BoB robotics includes
+#include "common/assert.h"
+
+#include "hash.h"
+#include "profiler.h"
+
+using namespace BoBRobotics;
+
+//------------------------------------------------------------------------
+// Anonymous namespace
+//------------------------------------------------------------------------
+namespace
+{
+// Header written at start of snapshot cache files. Images start at s_SnapshotCacheImageOffset so they are page-aligned
+const char s_SnapshotCacheMagic[4] = {'S', 'N', 'P', 'C'};
+const int32_t s_SnapshotCacheVersion = 1;
+const size_t s_SnapshotCacheImageOffset = 4096;
+}   // Anonymous namespace
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+uint64_t hashDatabaseImages(const Navigation::ImageDatabase &database)
+{
+    FNV1AHash hash;
+    hash.update(database.size());
+    for(const auto &e : database) {
+        struct stat status;
+        if(stat(e.path.str().c_str(), &status) != 0) {
+            throw std::runtime_error("Could not stat " + e.path.str());
+        }
+
+        // Hash canonical path so the same images reached through different relative paths or symlinks hash the same
+        hash.update(e.path.make_absolute().str());
+        hash.update((int64_t)status.st_size);
+        hash.update((int64_t)status.st_mtim.tv_sec);
+        hash.update((int64_t)status.st_mtim.tv_nsec);
+    }
+    return hash.get();
+}
+
+//------------------------------------------------------------------------
+// SnapshotCache
+//------------------------------------------------------------------------
+SnapshotCache::SnapshotCache(const Navigation::ImageDatabase &database, const cv::Size &imSize, unsigned int numThreads)
+:   m_ImageSize(imSize), m_NumImages(database.size()), m_ImageData(nullptr), m_MappedData(nullptr), m_MappedLength(0)
+{
+    std::vector<size_t> indices(database.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    load(database, indices, "", numThreads);
+}
+//------------------------------------------------------------------------
+SnapshotCache::SnapshotCache(const Navigation::ImageDatabase &database, const cv::Size &imSize,
+                             const std::vector<size_t> &indices, unsigned int numThreads)
+:   m_ImageSize(imSize), m_NumImages(indices.size()), m_Slots(database.size(), std::numeric_limits<size_t>::max()),
+    m_ImageData(nullptr), m_MappedData(nullptr), m_MappedLength(0)
+{
+    BOB_ASSERT(std::adjacent_find(indices.cbegin(), indices.cend(), std::greater_equal<size_t>()) == indices.cend());
+    BOB_ASSERT(indices.empty() || indices.back() < database.size());
+
+    // Find where each database image will be in cache
+    FNV1AHash indicesHash;
+    indicesHash.update(indices.size());
+    for(size_t s = 0; s < indices.size(); s++) {
+        m_Slots[indices[s]] = s;
+        indicesHash.update((uint64_t)indices[s]);
+    }
+
+    // Key filename by indices so caches of different subsets can sit alongside each other
+    std::ostringstream cacheSuffix;
+    cacheSuffix << "_" << std::hex << indicesHash.get();
+    load(database, indices, cacheSuffix.str(), numThreads);
+}
+//------------------------------------------------------------------------
+SnapshotCache::~SnapshotCache()
+{
+    unmap();
+}
+//------------------------------------------------------------------------
+cv::Mat SnapshotCache::operator[](size_t index) const
+{
+    size_t slot = index;
+    if(!m_Slots.empty()) {
+        BOB_ASSERT(index < m_Slots.size());
+        slot = m_Slots[index];
+    }
+    BOB_ASSERT(slot < m_NumImages);
+    return cv::Mat(m_ImageSize, CV_8UC1, const_cast<uint8_t *>(m_ImageData + (slot * m_ImageSize.area())));
+}
+//------------------------------------------------------------------------
+void SnapshotCache::load(const Navigation::ImageDatabase &database, const std::vector<size_t> &indices,
+                         const std::string &cacheSuffix, unsigned int numThreads)
+{
+    BOB_ASSERT(numThreads > 0);
+
+    // Cache sits alongside database, keyed by image size and any subset
+    std::ostringstream cacheFilename;
+    cacheFilename << "snapshots_" << m_ImageSize.width << "x" << m_ImageSize.height << cacheSuffix << ".bin";
+    const filesystem::path cachePath = filesystem::path(database.getPath()) / cacheFilename.str();
+
+    FNV1AHash databaseHash;
+    databaseHash.update(m_ImageSize.width);
+    databaseHash.update(m_ImageSize.height);
+    databaseHash.update(cacheSuffix);
+    databaseHash.update(hashDatabaseImages(database));
+    if(cachePath.exists() && map(cachePath, databaseHash.get())) {
+        std::cout << "Mapped " << m_NumImages << " snapshots from " << cachePath << std::endl;
+    }
+    else {
+        build(database, indices, cachePath, databaseHash.get(), numThreads);
+    }
+}
+//------------------------------------------------------------------------
+bool SnapshotCache::map(const filesystem::path &cachePath, uint64_t databaseHash)
+{
+    const int fd = open(cachePath.str().c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+
+    // Check file is large enough for header and images and map it
+    struct stat status;
+    const size_t length = s_SnapshotCacheImageOffset + (m_NumImages * m_ImageSize.area());
+    if(fstat(fd, &status) != 0 || (size_t)status.st_size != length) {
+        close(fd);
+        std::cerr << "Snapshot cache " << cachePath << " has wrong size - rebuilding" << std::endl;
+        return false;
+    }
+    void *data = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return false;
+    }
+    m_MappedData = data;
+    m_MappedLength = length;
+
+    // Check header matches
+    const char *header = reinterpret_cast<const char *>(data);
+    int32_t version;
+    int32_t size[2];
+    uint64_t numImages;
+    uint64_t hash;
+    std::copy_n(header + 4, sizeof(version), reinterpret_cast<char *>(&version));
+    std::copy_n(header + 8, sizeof(size), reinterpret_cast<char *>(size));
+    std::copy_n(header + 16, sizeof(numImages), reinterpret_cast<char *>(&numImages));
+    std::copy_n(header + 24, sizeof(hash), reinterpret_cast<char *>(&hash));
+    if(!std::equal(std::begin(s_SnapshotCacheMagic), std::end(s_SnapshotCacheMagic), header)
+        || version != s_SnapshotCacheVersion || size[0] != m_ImageSize.width || size[1] != m_ImageSize.height
+        || numImages != m_NumImages || hash != databaseHash)
+    {
+        unmap();
+        std::cerr << "Snapshot cache " << cachePath << " does not match database - rebuilding" << std::endl;
+        return false;
+    }
+
+    // Only images which will be tested or trained on are cached so read whole file now rather than faulting pages in one at a time
+    madvise(m_MappedData, m_MappedLength, MADV_WILLNEED);
+    m_ImageData = reinterpret_cast<const uint8_t *>(header) + s_SnapshotCacheImageOffset;
+    return true;
+}
+//------------------------------------------------------------------------
+void SnapshotCache::build(const Navigation::ImageDatabase &database, const std::vector<size_t> &indices,
+                          const filesystem::path &cachePath, uint64_t databaseHash, unsigned int numThreads)
+{
+    // Load and resize images directly into packed buffer, handing out images to threads in order
+    m_Images.resize(m_NumImages * m_ImageSize.area());
+    std::atomic<size_t> nextImage{0};
+    auto loadImages =
+        [&]()
+        {
+            while(true) {
+                const size_t i = nextImage++;
+                if(i >= m_NumImages) {
+                    break;
+                }
+
+                cv::Mat image;
+                {
+                    Profiler::ScopedTimer timer("Image decode");
+                    image = database[indices[i]].loadGreyscale();
+                }
+
+                Profiler::ScopedTimer timer("Image resize");
+                cv::Mat resized(m_ImageSize, CV_8UC1, &m_Images[i * m_ImageSize.area()]);
+                cv::resize(image, resized, m_ImageSize);
+            }
+        };
+
+    std::vector<std::thread> threads;
+    for(unsigned int t = 1; t < numThreads; t++) {
+        threads.emplace_back(loadImages);
+    }
+    loadImages();
+    for(auto &t : threads) {
+        t.join();
+    }
+    m_ImageData = m_Images.data();
+
+    // Write to temporary file and then rename so concurrent runs never see a partial cache
+    const std::string temporaryPath = cachePath.str() + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream os(temporaryPath, std::ios::binary);
+        const int32_t size[2] = { m_ImageSize.width, m_ImageSize.height };
+        const uint64_t numImages = m_NumImages;
+        os.write(s_SnapshotCacheMagic, sizeof(s_SnapshotCacheMagic));
+        os.write(reinterpret_cast<const char *>(&s_SnapshotCacheVersion), sizeof(s_SnapshotCacheVersion));
+        os.write(reinterpret_cast<const char *>(size), sizeof(size));
+        os.write(reinterpret_cast<const char *>(&numImages), sizeof(numImages));
+        os.write(reinterpret_cast<const char *>(&databaseHash), sizeof(databaseHash));
+
+        // Pad header so images are page-aligned
+        const std::vector<char> padding(s_SnapshotCacheImageOffset - 32, 0);
+        os.write(padding.data(), padding.size());
+        os.write(reinterpret_cast<const char *>(m_Images.data()), m_Images.size());
+        if(!os.good()) {
+            std::remove(temporaryPath.c_str());
+            std::cerr << "Could not write snapshot cache " << cachePath << " - keeping " << m_NumImages << " snapshots in memory" << std::endl;
+            return;
+        }
+    }
+
+    if(std::rename(temporaryPath.c_str(), cachePath.str().c_str()) != 0) {
+        std::remove(temporaryPath.c_str());
+        std::cerr << "Could not write snapshot cache " << cachePath << " - keeping " << m_NumImages << " snapshots in memory" << std::endl;
+    }
+    else {
+        std::cout << "Wrote " << m_NumImages << " snapshots to " << cachePath << std::endl;
+    }
+}
+//------------------------------------------------------------------------
+void SnapshotCache::unmap()
+{
+    if(m_MappedData != nullptr) {
+        munmap(m_MappedData, m_MappedLength);
+        m_MappedData = nullptr;
+        m_MappedLength = 0;
+    }
+}
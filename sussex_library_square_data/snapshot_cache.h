@@ -0,0 +1,91 @@
+#pragma once
+
+// Standard C++ includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// BoB robotics 3rd party includes
+#include "third_party/path.h"
+
+// BoB robotics includes
+#include "navigation/image_database.h"
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+// Hash the canonical path, size and modification time of every image in database
+uint64_t hashDatabaseImages(const BoBRobotics::Navigation::ImageDatabase &database);
+
+//------------------------------------------------------------------------
+// SnapshotCache
+//------------------------------------------------------------------------
+// Every image in a database, or a subset of them, loaded as greyscale and resized. Images are cached in a packed
+// binary file alongside database_entries.csv, keyed by image size, the indices of any subset and the paths, sizes
+// and modification times of the source images, which is memory-mapped on later runs rather than decoding and
+// resizing every image again. If the cache can't be written, images are kept in memory instead
+class SnapshotCache
+{
+public:
+    // If the cache needs building, images are loaded and resized using numThreads threads
+    SnapshotCache(const BoBRobotics::Navigation::ImageDatabase &database, const cv::Size &imSize, unsigned int numThreads = 1);
+
+    // Only load images with database indices, which must be in ascending order
+    SnapshotCache(const BoBRobotics::Navigation::ImageDatabase &database, const cv::Size &imSize,
+                  const std::vector<size_t> &indices, unsigned int numThreads = 1);
+    ~SnapshotCache();
+
+    SnapshotCache(const SnapshotCache &) = delete;
+    SnapshotCache &operator=(const SnapshotCache &) = delete;
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    // Get image by database index, which must have been loaded. **NOTE** image refers to the cache's
+    // memory so must not be written to and is only valid for the lifetime of the cache
+    cv::Mat operator[](size_t index) const;
+
+    // Number of images loaded
+
+    size_t size() const{ return m_NumImages; }
+    const cv::Size &getImageSize() const{ return m_ImageSize; }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    // Map cache file if it matches or load images and build it
+    void load(const BoBRobotics::Navigation::ImageDatabase &database, const std::vector<size_t> &indices,
+              const std::string &cacheSuffix, unsigned int numThreads);
+
+    // Map cache file, returning false if it doesn't exist or doesn't match
+    bool map(const filesystem::path &cachePath, uint64_t databaseHash);
+
+    // Load and resize images into memory and try to write cache file
+    void build(const BoBRobotics::Navigation::ImageDatabase &database, const std::vector<size_t> &indices,
+               const filesystem::path &cachePath, uint64_t databaseHash, unsigned int numThreads);
+
+    void unmap();
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const cv::Size m_ImageSize;
+    size_t m_NumImages;
+
+    // Position in cache of each database image or SIZE_MAX if not loaded - empty if every image is loaded
+    std::vector<size_t> m_Slots;
+
+    // Start of packed images - either within mapping or m_Images
+    const uint8_t *m_ImageData;
+
+    // Memory-mapped cache file
+    void *m_MappedData;
+    size_t m_MappedLength;
+
+    // Images loaded into memory if cache needed building
+    std::vector<uint8_t> m_Images;
+};
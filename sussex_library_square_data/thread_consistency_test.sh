@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# Check that vector fields calculated with several threads are identical to those calculated with one, for every memory
+# type. Any arguments are passed to ./vector_field e.g. --route. Exits with a non-zero status if any outputs differ
+MEMORY_TYPES=( PerfectMemory PerfectMemoryConstrained PerfectMemoryANN PerfectMemorySequence InfoMax InfoMaxConstrained )
+THREADS=4
+
+OUTPUT_DIRECTORY=benchmark_results/thread_consistency
+mkdir -p "${OUTPUT_DIRECTORY}"
+
+FAILED=0
+for m in "${MEMORY_TYPES[@]}"; do
+    for t in 1 ${THREADS}; do
+        ./vector_field --memory-type=$m --threads=$t --checkpoint-points=0 --checkpoint-seconds=0 \
+            --output-csv="${OUTPUT_DIRECTORY}/${m}_${t}.csv" --output-image="${OUTPUT_DIRECTORY}/${m}_${t}.png" "$@" > /dev/null || exit 1
+    done
+
+    if cmp -s "${OUTPUT_DIRECTORY}/${m}_1.csv" "${OUTPUT_DIRECTORY}/${m}_${THREADS}.csv"; then
+        echo "${m}: PASSED"
+    else
+        echo "${m}: FAILED - CSV calculated with ${THREADS} threads differs from CSV calculated with 1"
+        FAILED=1
+    fi
+done
+exit $FAILED
@@ -1,3 +1,7 @@
+// Standard C++ includes
+#include <chrono>
+#include <fstream>
+
 // OpenCV
 #include <opencv2/opencv.hpp>
 
@@ -7,13 +11,15 @@
 // BoB robotics includes
 #include "navigation/image_database.h"
 
-// PSimpl includes
-#include "psimpl.h"
-
 // CLI11 includes
 #include "CLI11.hpp"
 
+#include "grid_evaluation.h"
 #include "memory.h"
+#include "memory_factory.h"
+#include "profiler.h"
+#include "render_checkpointer.h"
+#include "route.h"
 
 using namespace BoBRobotics;
 using namespace units::literals;
@@ -22,112 +28,6 @@ using namespace units::angle;
 using namespace units::math;
 using namespace units::solid_angle;
 
-//------------------------------------------------------------------------
-// Anonymous namespace
-//------------------------------------------------------------------------
-namespace
-{
-void processRoute(const Navigation::ImageDatabase &database, double decimate,
-                  cv::Mat &renderMatFull, cv::Mat &renderMatDecimated,
-                  std::vector<cv::Point2f> &decimatedPoints)
-{
-
-    std::vector<float> routePointComponents;
-    routePointComponents.reserve(database.size() * 2);
-
-    {
-        // Reserve temporary vector to hold route points, snapped to integer pixels
-        std::vector<cv::Point2i> routePointPixels;
-        routePointPixels.reserve(database.size());
-
-        // Loop through route
-        for(const auto &r : database) {
-            // Get position of point in cm
-            const centimeter_t x = r.position[0];
-            const centimeter_t y = r.position[1];
-
-            // Add x and y components of position to vector
-            routePointComponents.emplace_back(x.value());
-            routePointComponents.emplace_back(y.value());
-
-            // Add x and y pixel values
-            routePointPixels.emplace_back((int)std::round(x.value()), (int)std::round(y.value()));
-        }
-
-        // Build render matrix from route point pixels
-        renderMatFull = cv::Mat(routePointPixels, true);
-    }
-
-    // Decimate route points
-    std::vector<float> decimatedRoutePointComponents;
-    psimpl::simplify_douglas_peucker<2>(routePointComponents.cbegin(), routePointComponents.cend(),
-                                        decimate,
-                                        std::back_inserter(decimatedRoutePointComponents));
-
-    decimatedPoints.reserve(decimatedRoutePointComponents.size() / 2);
-
-    {
-        // Reserve temporary vector to hold decimated route points, snapped to integer pixels
-        std::vector<cv::Point2i> decimatedPixels;
-        decimatedPixels.reserve(decimatedRoutePointComponents.size() / 2);
-
-        for(size_t i = 0; i < decimatedRoutePointComponents.size(); i += 2) {
-            const float x = decimatedRoutePointComponents[i];
-            const float y = decimatedRoutePointComponents[i + 1];
-
-            decimatedPixels.emplace_back((int)std::round(x), (int)std::round(y));
-
-            decimatedPoints.emplace_back(x, y);
-        }
-
-        // Build render matrix from decimated pixels
-        renderMatDecimated = cv::Mat(decimatedPixels, true);
-    }
-}
-//------------------------------------------------------------------------
-// Get distance to route from point
-std::tuple<centimeter_t, cv::Point2f, size_t, degree_t> getNearestPointOnRoute(const cv::Point2f &point,
-                                                                               const std::vector<cv::Point2f> &routePoints)
-{
-    // Loop through points
-    float shortestDistanceSquared = std::numeric_limits<float>::max();
-    cv::Point2f nearestPoint;
-    size_t nearestSegment;
-    for(size_t i = 0; i < (routePoints.size() - 1); i++) {
-        // Get vector pointing along segment and it's squared
-        const cv::Point2f segmentVector = routePoints[i + 1] - routePoints[i];
-        const float segmentLengthSquared = segmentVector.dot(segmentVector);
-
-        // Get vector from start of segment to point
-        const cv::Point2f segmentStartToPoint = point - routePoints[i];
-
-        // Take dot product of two vectors and normalise, clamping at 0 and 1
-        const float t = std::max(0.0f, std::min(1.0f, segmentStartToPoint.dot(segmentVector) / segmentLengthSquared));
-
-        // Find nearest point on the segment
-        const cv::Point2f nearestPointOnSegment = routePoints[i] + (t * segmentVector);
-
-        // Get the vector from here to our point and hence the squared distance
-        const cv::Point2f shortestSegmentToPoint = point - nearestPointOnSegment;
-        const float distanceSquared = shortestSegmentToPoint.dot(shortestSegmentToPoint);
-
-        // If this is shorter than current best, update current
-        if(distanceSquared < shortestDistanceSquared) {
-            shortestDistanceSquared = distanceSquared;
-            nearestPoint = nearestPointOnSegment;
-            nearestSegment = i;
-        }
-    }
-
-    // Get vector in direction of nearest segment and hence heading
-    const cv::Point2f nearestSegmentVector = routePoints[nearestSegment + 1] - routePoints[nearestSegment];
-    const degree_t nearestSegmentHeading = radian_t(std::atan2(nearestSegmentVector.y, nearestSegmentVector.x));
-
-    // Return shortest distance and position of nearest point
-    return std::make_tuple(centimeter_t(std::sqrt(shortestDistanceSquared)), nearestPoint, nearestSegment, nearestSegmentHeading);
-}
-}   // Anonymous namespace
-
 int main(int argc, char **argv)
 {
     // Default command line arguments
@@ -138,12 +38,16 @@ int main(int argc, char **argv)
     std::string outputImageName = "grid_image.png";
     std::string outputCSVName = "";
     std::string memoryType = "PerfectMemory";
-    bool renderGoodMatches = true;
-    bool renderBadMatches = false;
+    MemoryParameters memoryParameters;
+    std::string routeLookup = "SegmentIndex";
     bool renderRoute = true;
     bool renderDecimatedRoute = true;
-    double fovDegrees = 90.0;
     double decimateDistance = 15.0;
+    unsigned int numThreads = 1;
+    size_t checkpointPoints = 500;
+    double checkpointSeconds = 10.0;
+    bool profile = false;
+    std::string profileOutputName = "profile.json";
 
     // Configure command line parser
     CLI::App app{"BoB robotics 'vector field' renderer"};
@@ -155,13 +59,21 @@ int main(int argc, char **argv)
     app.add_option("--output-image", outputImageName, "Name of output image to generate", true);
     app.add_option("--output-csv", outputCSVName, "Name of output CSV to generate", true);
     app.add_option("--decimate-distance", decimateDistance, "Threshold (in cm) for decimating route points", true);
-    app.add_option("--fov", fovDegrees,
-                   "For 'constrained' memories, what angle (in degrees) on either side of route should snapshots be matched in", true);
-    app.add_set("--memory-type", memoryType, {"PerfectMemory", "PerfectMemoryConstrained", "InfoMax", "InfoMaxConstrained"},
+    app.add_option("--threads", numThreads, "Number of threads to evaluate grid points with", true);
+    app.add_option("--checkpoint-points", checkpointPoints,
+                   "Write output image after this many grid points have been rendered (0 to disable)", true);
+    app.add_option("--checkpoint-seconds", checkpointSeconds,
+                   "Write output image after this many seconds have elapsed (0 to disable)", true);
+    app.add_set("--memory-type", memoryType, {"PerfectMemory", "PerfectMemoryConstrained", "PerfectMemoryANN", "PerfectMemorySequence", "InfoMax", "InfoMaxConstrained"},
                 "Type of memory to use for navigation", true);
-    /*app.add_flag("--render-good-matches,--no-render-good-matches{false}", renderGoodMatches,
+    addMemoryOptions(app, memoryParameters);
+    app.add_flag("--profile", profile, "Time each stage and write a summary to the profile output when finished");
+    app.add_option("--profile-output", profileOutputName, "Name of JSON file to write profile summary to", true);
+    app.add_set("--route-lookup", routeLookup, {"Linear", "SegmentIndex", "Raster", "SIMD"},
+                "How to find nearest point on route to each grid point", true);
+    /*app.add_flag("--render-good-matches,--no-render-good-matches{false}", memoryParameters.renderGoodMatches,
                  "Should lines be rendered between grid points and 'good' matches");
-    app.add_flag("--render-bad-matches,!--no-render-bad-matches", renderBadMatches,
+    app.add_flag("--render-bad-matches,!--no-render-bad-matches", memoryParameters.renderBadMatches,
                  "Should lines be rendered between grid points and 'bad' matches");
     app.add_flag("--render-route,!--no-render-route", renderRoute,
                  "Should unprocessed route be rendered");
@@ -172,49 +84,35 @@ int main(int argc, char **argv)
     // Parse command line arguments
     CLI11_PARSE(app, argc, argv);
 
+    Profiler::setEnabled(profile);
+    const auto startTime = std::chrono::steady_clock::now();
+
     // Create database from route
     const filesystem::path routePath = filesystem::path("routes") / routeName / variantName;
     std::cout << routePath << std::endl;
+    Profiler::ScopedTimer routeLoadingTimer("Route loading");
     Navigation::ImageDatabase route(routePath);
+    routeLoadingTimer.stop();
 
-    std::unique_ptr<MemoryBase> memory;
-    if(memoryType == "PerfectMemory") {
-        memory.reset(new PerfectMemory(imSize, route,
-                                       renderGoodMatches, renderBadMatches));
-    }
-    else if(memoryType == "PerfectMemoryConstrained") {
-        memory.reset(new PerfectMemoryConstrained(imSize, route, degree_t(fovDegrees),
-                                                  renderGoodMatches, renderBadMatches));
-    }
-    else if(memoryType == "InfoMax") {
-        memory.reset(new InfoMax(imSize, route));
-    }
-    else if(memoryType == "InfoMaxConstrained") {
-        memory.reset(new InfoMaxConstrained(imSize, route, degree_t(fovDegrees)));
-    }
-    else {
-        throw std::runtime_error("Memory type '" + memoryType + "' not supported");
-    }
+    BOB_ASSERT(numThreads > 0);
+    memoryParameters.infoMaxTraining.numThreads = numThreads;
+
+    // Create memory
+    const auto memory = createMemory(memoryType, imSize, route, memoryParameters);
 
     // Process routes to get render images
     std::vector<cv::Point2f> decimatedRoutePoints;
     cv::Mat routePointsMat;
     cv::Mat decimatedRoutePointMat;
-    processRoute(route, decimateDistance, routePointsMat, decimatedRoutePointMat, decimatedRoutePoints);
+    {
+        Profiler::ScopedTimer timer("Route processing");
+        processRoute(route, decimateDistance, routePointsMat, decimatedRoutePointMat, decimatedRoutePoints);
+    }
 
     // Load grid
-    Navigation::ImageDatabase grid = filesystem::path("image_grids") /  imageGridName / variantName;
-    assert(grid.isGrid());
-    assert(grid.hasMetadata());
-
-    // Read grid dimensions from meta data
-    std::vector<double> size, seperationMM;
-    grid.getMetadata()["grid"]["separationMM"] >> seperationMM;
-    grid.getMetadata()["grid"]["size"] >> size;
-    assert(size.size() == 3);
-    assert(seperationMM.size() == 3);
-
-    std::cout << size[0] << "x" << size[1] << " grid with " << seperationMM[0] << "x" << seperationMM[1] << "mm squares" << std::endl;
+    Profiler::ScopedTimer gridLoadingTimer("Grid loading");
+    ImageGrid grid(filesystem::path("image_grids") / imageGridName / variantName, imSize);
+    gridLoadingTimer.stop();
 
     // If a filename is specified, open CSV file other write to std::cout
     std::ofstream outputCSVFile;
@@ -228,9 +126,16 @@ int main(int argc, char **argv)
     outputCSV << std::endl;
 
     // Make a grid image with one pixel per cm
-    cv::Mat gridImage((int)std::round(size[1] * seperationMM[1] * 0.1), 
-                      (int)std::round(size[0] * seperationMM[0] * 0.1), 
-                      CV_8UC3, cv::Scalar::all(0));
+    cv::Mat gridImage(grid.getRenderSize(), CV_8UC3, cv::Scalar::all(0));
+
+    // Find nearest point on decimated route to every grid point
+    const auto gridNearestPoints = findNearestRoutePoints(routeLookup, decimatedRoutePoints, grid, routePath, decimateDistance);
+
+    // Get resized snapshots of grid points within R.O.I. of route, building cache in parallel if necessary
+    {
+        Profiler::ScopedTimer timer("Grid snapshot loading");
+        grid.loadSnapshots(getROIIndices(gridNearestPoints), numThreads);
+    }
 
     // Draw route onto image
     if(renderRoute) {
@@ -241,53 +146,32 @@ int main(int argc, char **argv)
         cv::polylines(gridImage, decimatedRoutePointMat, false, CV_RGB(255, 255, 255));
     }
 
-    // Loop through grid entries
-    size_t numGridPointsWithinROI = 0;
-    degree_squared_t sumSquareError = 0_sq_deg;
-    for(const auto &g : grid) {
-        const centimeter_t x = g.position[0];
-        const centimeter_t y = g.position[1];
-
-        // Get distance from grid point to route
-        const auto nearestPoint = getNearestPointOnRoute(cv::Point2f(x.value(), y.value()), decimatedRoutePoints);
+    // Periodically write output image in the background while grid is being evaluated
+    RenderCheckpointer renderCheckpointer(outputImageName, checkpointPoints, checkpointSeconds);
 
-        // If snapshot is within R.O.I.
-        if(std::get<0>(nearestPoint) < 4_m) {
-            // Increment count
-            numGridPointsWithinROI++;
+    // Evaluate grid, checkpointing output image as grid points are committed
+    Profiler::ScopedTimer gridEvaluationTimer("Grid evaluation");
+    WorkerPool workerPool(numThreads);
+    const degree_t rmse = evaluateGrid(grid, gridNearestPoints, *memory, workerPool, &outputCSV, &gridImage,
+                                       [&renderCheckpointer, &gridImage](){ renderCheckpointer.update(gridImage); });
+    gridEvaluationTimer.stop();
 
-            // Load snapshot and resize
-            cv::Mat snapshot = g.loadGreyscale();
-            cv::resize(snapshot, snapshot, imSize);
-
-            // Test snapshot using memory
-            memory->test(snapshot, g.heading, std::get<3>(nearestPoint));
-
-            // Get magnitude of shortest angle between route and headig
-            const degree_t angularError = shortestAngleBetween(memory->getBestHeading(), std::get<3>(nearestPoint));
-
-            // Add to sum square error
-            sumSquareError += (angularError * angularError);
-
-            // Draw arrow showing vector field
-            const centimeter_t xEnd = x + (60_cm * memory->getVectorLength() * cos(memory->getBestHeading()));
-            const centimeter_t yEnd = y + (60_cm * memory->getVectorLength() * sin(memory->getBestHeading()));
-            cv::arrowedLine(gridImage, cv::Point(x.value(), y.value()), cv::Point(xEnd.value(), yEnd.value()),
-                            CV_RGB(0, 0, 255));
-
-            // Write CSV line
-            memory->writeCSVLine(outputCSV, x, y, angularError);
-            outputCSV << std::endl;
+    // Write final output image
+    {
+        Profiler::ScopedTimer timer("Output image writing");
+        renderCheckpointer.finish(gridImage);
+    }
 
-            // Perform any memory-specific additional rendering
-            memory->render(gridImage, x, y);
+    // Write profile summary
+    if(profile) {
+        const std::chrono::duration<double> totalTime = std::chrono::steady_clock::now() - startTime;
+        Profiler::addDuration("Total", totalTime.count());
 
-            // Update output image
-            cv::imwrite(outputImageName, gridImage);
-        }
+        std::ofstream profileOutput(profileOutputName);
+        Profiler::writeJSON(profileOutput);
     }
 
-    std::cout << "RMSE:" << degree_t(sqrt(sumSquareError / (double)numGridPointsWithinROI)) << std::endl;
+    std::cout << "RMSE:" << rmse << std::endl;
 
 
     return EXIT_SUCCESS;
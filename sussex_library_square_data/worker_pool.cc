@@ -0,0 +1,173 @@
+#include "worker_pool.h"
+
+// Eigen
+#include <Eigen/Core>
+
+// BoB robotics includes
+#include "common/assert.h"
+
+//------------------------------------------------------------------------
+// ScopedEigenThreads
+//------------------------------------------------------------------------
+ScopedEigenThreads::ScopedEigenThreads(int numThreads)
+:   m_PreviousNumThreads(Eigen::nbThreads())
+{
+    BOB_ASSERT(numThreads > 0);
+    Eigen::setNbThreads(numThreads);
+}
+//------------------------------------------------------------------------
+ScopedEigenThreads::~ScopedEigenThreads()
+{
+    Eigen::setNbThreads(m_PreviousNumThreads);
+}
+
+//------------------------------------------------------------------------
+// WorkerPool
+//------------------------------------------------------------------------
+WorkerPool::WorkerPool(unsigned int numThreads)
+:   m_NumThreads(numThreads), m_Stopping(false), m_Batch(0), m_NumBusyWorkers(0), m_NumItems(0),
+    m_Process(nullptr), m_Commit(nullptr), m_NextItem(0), m_NextItemToCommit(0), m_Aborted(false)
+{
+    BOB_ASSERT(numThreads > 0);
+
+    // If any worker thread can't be created, stop those that were before rethrowing
+    try {
+        for(unsigned int t = 1; t < numThreads; t++) {
+            m_WorkerThreads.emplace_back(&WorkerPool::workerThread, this, t);
+        }
+    }
+    catch(...) {
+        stop();
+        throw;
+    }
+}
+//------------------------------------------------------------------------
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+//------------------------------------------------------------------------
+void WorkerPool::runOrdered(size_t numItems, const std::function<void(size_t, unsigned int)> &process,
+                            const std::function<void(size_t, unsigned int)> &commit)
+{
+    // If items are processed in parallel, stop Eigen also parallelising each matrix product
+    const ScopedEigenThreads eigenThreads((m_NumThreads > 1) ? 1 : Eigen::nbThreads());
+
+    // Start batch on worker threads
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_NumItems = numItems;
+        m_Process = &process;
+        m_Commit = &commit;
+        m_NextItem = 0;
+        m_NextItemToCommit = 0;
+        m_Aborted = false;
+        m_FirstException = nullptr;
+        m_NumBusyWorkers = (unsigned int)m_WorkerThreads.size();
+        m_Batch++;
+    }
+    m_BatchCondition.notify_all();
+
+    // Process batch on this thread and wait for worker threads to finish
+    processBatch(0);
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_DoneCondition.wait(lock, [this](){ return m_NumBusyWorkers == 0; });
+
+    // Rethrow first exception on calling thread
+    if(m_FirstException) {
+        std::rethrow_exception(m_FirstException);
+    }
+}
+//------------------------------------------------------------------------
+void WorkerPool::workerThread(unsigned int thread)
+{
+    uint64_t lastBatch = 0;
+    while(true) {
+        // Wait for a new batch or for pool to stop
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_BatchCondition.wait(lock, [this, lastBatch](){ return m_Stopping || m_Batch != lastBatch; });
+            if(m_Stopping) {
+                return;
+            }
+            lastBatch = m_Batch;
+        }
+
+        processBatch(thread);
+
+        // Signal that this thread has finished batch
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_NumBusyWorkers--;
+        }
+        m_DoneCondition.notify_all();
+    }
+}
+//------------------------------------------------------------------------
+void WorkerPool::processBatch(unsigned int thread)
+{
+    try {
+        while(!m_Aborted) {
+            // Get next item, stopping if there are none left
+            const size_t i = m_NextItem++;
+            if(i >= m_NumItems) {
+                break;
+            }
+
+            (*m_Process)(i, thread);
+
+            // Wait until all preceding items have been committed or another thread has thrown
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_CommitCondition.wait(lock, [this, i](){ return m_Aborted || m_NextItemToCommit == i; });
+            if(m_Aborted) {
+                break;
+            }
+
+            (*m_Commit)(i, thread);
+
+            // Allow next item to be committed
+            m_NextItemToCommit++;
+            lock.unlock();
+            m_CommitCondition.notify_all();
+        }
+    }
+    catch(...) {
+        abortBatch();
+    }
+}
+//------------------------------------------------------------------------
+void WorkerPool::abortBatch()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if(!m_FirstException) {
+            m_FirstException = std::current_exception();
+        }
+        m_Aborted = true;
+    }
+    m_CommitCondition.notify_all();
+}
+//------------------------------------------------------------------------
+void WorkerPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_BatchCondition.notify_all();
+    for(auto &w : m_WorkerThreads) {
+        w.join();
+    }
+    m_WorkerThreads.clear();
+}
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+void runOrdered(unsigned int numThreads, size_t numItems,
+                const std::function<void(size_t, unsigned int)> &process,
+                const std::function<void(size_t, unsigned int)> &commit)
+{
+    WorkerPool workerPool(numThreads);
+    workerPool.runOrdered(numItems, process, commit);
+}
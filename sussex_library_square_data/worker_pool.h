@@ -0,0 +1,111 @@
+#pragma once
+
+// Standard C++ includes
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------
+// ScopedEigenThreads
+//------------------------------------------------------------------------
+// Sets the number of threads Eigen parallelises matrix products across with OpenMP, restoring it when destroyed.
+// **NOTE** this is process-wide and, as every object is built with -fopenmp, an Eigen product on any thread
+// forks an OpenMP team of this size - it should only be > 1 while a single thread is running products
+class ScopedEigenThreads
+{
+public:
+    ScopedEigenThreads(int numThreads);
+    ~ScopedEigenThreads();
+
+    ScopedEigenThreads(const ScopedEigenThreads &) = delete;
+    ScopedEigenThreads &operator=(const ScopedEigenThreads &) = delete;
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const int m_PreviousNumThreads;
+};
+
+//------------------------------------------------------------------------
+// WorkerPool
+//------------------------------------------------------------------------
+// Persistent pool of numThreads - 1 worker threads which, along with the thread calling runOrdered, process
+// batches of items. Threads are created once and wait between batches so a pool can be shared by many batches
+class WorkerPool
+{
+public:
+    WorkerPool(unsigned int numThreads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    // Process items [0, numItems) on this thread and the worker threads. Items are handed out to threads in order
+    // but, so outputs are identical to a serial run, each is then 'committed' strictly in order - commit is called
+    // for item i on the thread which processed it, under a lock, once all preceding items have been committed. Both
+    // functions are passed the item and the index of the thread (this thread is 0). While items are processed in
+    // parallel, Eigen is limited to one thread so products on worker threads don't each fork an OpenMP team. If either
+    // function throws, no further items are processed or committed and the first exception is rethrown on this thread
+    void runOrdered(size_t numItems, const std::function<void(size_t, unsigned int)> &process,
+                    const std::function<void(size_t, unsigned int)> &commit);
+
+    unsigned int getNumThreads() const{ return m_NumThreads; }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    // Wait for batches and process them until pool is destroyed
+    void workerThread(unsigned int thread);
+
+    // Process and commit items from current batch until there are none left or a thread throws
+    void processBatch(unsigned int thread);
+
+    // Store current exception, if it's the first, and stop batch
+    void abortBatch();
+
+    // Stop and join worker threads
+    void stop();
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const unsigned int m_NumThreads;
+    std::vector<std::thread> m_WorkerThreads;
+
+    // Lock protecting batch state, signalled when a batch starts, an item is committed and a worker finishes a batch
+    std::mutex m_Mutex;
+    std::condition_variable m_BatchCondition;
+    std::condition_variable m_CommitCondition;
+    std::condition_variable m_DoneCondition;
+    bool m_Stopping;
+
+    // Current batch - workers start processing when m_Batch changes
+    uint64_t m_Batch;
+    unsigned int m_NumBusyWorkers;
+    size_t m_NumItems;
+    const std::function<void(size_t, unsigned int)> *m_Process;
+    const std::function<void(size_t, unsigned int)> *m_Commit;
+    std::atomic<size_t> m_NextItem;
+    size_t m_NextItemToCommit;
+    std::atomic<bool> m_Aborted;
+    std::exception_ptr m_FirstException;
+};
+
+//------------------------------------------------------------------------
+// Free functions
+//------------------------------------------------------------------------
+// Process items with WorkerPool::runOrdered using a pool of numThreads threads created for this batch
+void runOrdered(unsigned int numThreads, size_t numItems,
+                const std::function<void(size_t, unsigned int)> &process,
+                const std::function<void(size_t, unsigned int)> &commit);